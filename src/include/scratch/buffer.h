@@ -0,0 +1,159 @@
+/*!
+ * \file buffer.h
+ *
+ * \par Copyright
+ * Copyright (C) 1999-2023 scratchmud.org
+ * All rights reserved.
+ *
+ * \author Geoffrey Davis <gdavis@scratchmud.org>
+ * \addtogroup buffer
+ */
+#ifndef _SCRATCH_BUFFER_H_
+#define _SCRATCH_BUFFER_H_
+
+#include <scratch/scratch.h>
+
+/*! The length of a buffer segment. */
+#define MAXLEN_SEGMENT		(1024 * 4)
+
+/* Forward type declarations */
+typedef struct Buffer Buffer;
+typedef struct BufferSegment BufferSegment;
+typedef struct BufferSlice BufferSlice;
+typedef struct Socket Socket;
+
+/*!
+ * The buffer segment structure.
+ * \addtogroup buffer
+ * \{
+ */
+struct BufferSegment {
+  size_t                capacity;       /*!< The segment data allocated */
+  char                 *data;           /*!< The segment data */
+  size_t                length;         /*!< The segment data used */
+  size_t                refs;           /*!< The reference count */
+};
+/*! \} */
+
+/*!
+ * The buffer slice structure.
+ * \addtogroup buffer
+ * \{
+ */
+struct BufferSlice {
+  size_t                length;         /*!< The unwritten slice length */
+  size_t                offset;         /*!< The slice offset into the segment */
+  BufferSegment        *segment;        /*!< The segment */
+};
+/*! \} */
+
+/*!
+ * The buffer structure.
+ * \addtogroup buffer
+ * \{
+ */
+struct Buffer {
+  size_t                length;         /*!< The unwritten buffer length */
+  size_t                limit;          /*!< The maximum buffer length */
+  BufferSlice          *slices;         /*!< The slice ring */
+  size_t                slicesFront;    /*!< The slice ring front index */
+  size_t                slicesMax;      /*!< The slices allocated */
+  size_t                slicesN;        /*!< The slices used */
+};
+/*! \} */
+
+/*!
+ * Constructs a new buffer.
+ * \addtogroup buffer
+ * \param limit the maximum unwritten buffer length, or zero for no
+ *     limit
+ * \return the new buffer or NULL
+ * \sa BufferFree(Buffer*)
+ * \sa BufferFreeV(void*)
+ */
+Buffer *BufferAlloc(const size_t limit);
+
+/*!
+ * Appends to a buffer.
+ * \addtogroup buffer
+ * \param buffer the buffer to which to append
+ * \param messg the message buffer
+ * \param messglen the length of the specified message buffer
+ * \return true if the message was appended, or false if appending
+ *     it would exceed the buffer limit
+ */
+bool BufferAppend(
+	Buffer *buffer,
+	const void *messg, const size_t messglen);
+
+/*!
+ * Appends a shared segment to a buffer without copying it.
+ * \addtogroup buffer
+ * \param buffer the buffer to which to append
+ * \param segment the segment to append
+ * \return true if the segment was appended, or false if appending
+ *     it would exceed the buffer limit
+ */
+bool BufferAppendSegment(
+	Buffer *buffer,
+	BufferSegment *segment);
+
+/*!
+ * Clears a buffer.
+ * \addtogroup buffer
+ * \param buffer the buffer to clear
+ */
+void BufferClear(Buffer *buffer);
+
+/*!
+ * Frees a buffer.
+ * \addtogroup buffer
+ * \param buffer the buffer to free
+ * \sa BufferAlloc(const size_t)
+ * \sa BufferFreeV(void*)
+ */
+void BufferFree(Buffer *buffer);
+
+/*!
+ * Frees a buffer.
+ * \addtogroup buffer
+ * \param buffer the buffer to free
+ * \sa BufferAlloc(const size_t)
+ * \sa BufferFree(Buffer*)
+ */
+void BufferFreeV(void *buffer);
+
+/*!
+ * Constructs a new buffer segment.
+ * \addtogroup buffer
+ * \param messg the message buffer, or NULL for an empty segment
+ * \param messglen the length of the specified message buffer, or the
+ *     capacity of the empty segment
+ * \return the new buffer segment, holding one reference
+ * \sa BufferSegmentFree(BufferSegment*)
+ */
+BufferSegment *BufferSegmentAlloc(
+	const void *messg, const size_t messglen);
+
+/*!
+ * Releases a reference to a buffer segment, freeing it with
+ * the last reference.
+ * \addtogroup buffer
+ * \param segment the buffer segment to release
+ * \sa BufferSegmentAlloc(const void*, const size_t)
+ */
+void BufferSegmentFree(BufferSegment *segment);
+
+/*!
+ * Writes a buffer to a socket until the buffer is empty or the
+ * socket would block.
+ * \addtogroup buffer
+ * \param buffer the buffer to write
+ * \param socket the socket to which to write
+ * \return the number of bytes written to the network stream, or -1
+ */
+ssize_t BufferWrite(
+	Buffer *buffer,
+	Socket *socket);
+
+#endif /* _SCRATCH_BUFFER_H_ */
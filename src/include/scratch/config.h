@@ -0,0 +1,82 @@
+/*!
+ * \file config.h
+ *
+ * \par Copyright
+ * Copyright (C) 1999-2023 scratchmud.org
+ * All rights reserved.
+ *
+ * \author Geoffrey Davis <gdavis@scratchmud.org>
+ * \addtogroup config
+ */
+#ifndef _SCRATCH_CONFIG_H_
+#define _SCRATCH_CONFIG_H_
+
+#include <scratch/log.h>
+#include <scratch/scratch.h>
+
+/* Forward type declarations */
+typedef struct Config Config;
+typedef struct Data Data;
+typedef struct Game Game;
+
+/*!
+ * The game configuration structure.
+ * \addtogroup config
+ * \{
+ */
+struct Config {
+  int                   logLevels[L_MAX]; /*!< The log level for each log type */
+  int                   logPolicy;      /*!< The log backpressure policy: LOG_x */
+  size_t                outputLimit;    /*!< The descriptor output limit */
+  char                 *poller;         /*!< The poller backend name */
+  size_t                resolverCacheMax; /*!< The maximum number of cached hostnames */
+  time_t                resolverCacheTtl; /*!< The hostname cache lifetime in seconds */
+  size_t                resolverWorkers; /*!< The number of resolver worker threads */
+};
+/*! \} */
+
+/*!
+ * Constructs a new game configuration.
+ * \addtogroup config
+ * \return the new game configuration with default settings
+ * \sa ConfigFree(Config*)
+ * \sa ConfigFreeV(void*)
+ */
+Config *ConfigAlloc(void);
+
+/*!
+ * Frees a game configuration.
+ * \addtogroup config
+ * \param config the game configuration to free
+ * \sa ConfigAlloc()
+ * \sa ConfigFreeV(void*)
+ */
+void ConfigFree(Config *config);
+
+/*!
+ * Frees a game configuration.
+ * \addtogroup config
+ * \param config the game configuration to free
+ * \sa ConfigAlloc()
+ * \sa ConfigFree(Config*)
+ */
+void ConfigFreeV(void *config);
+
+/*!
+ * Loads the game configuration.
+ * \addtogroup config
+ * \param game the game state
+ */
+void ConfigLoad(Game *game);
+
+/*!
+ * Parses a game configuration.
+ * \addtogroup config
+ * \param fromData the data element to parse
+ * \param toConfig the location of the parsed game configuration
+ */
+void ConfigParse(
+	Data *fromData,
+	Config *toConfig);
+
+#endif /* _SCRATCH_CONFIG_H_ */
@@ -13,10 +13,12 @@
 
 #include <scratch/scratch.h>
 
-/*! The length of a descriptor output buffer. */
-#define MAXLEN_OUTPUT		(1024 * 16)
+/*! The default maximum length of a descriptor output buffer. */
+#define MAXLEN_OUTPUT		(1024 * 256)
 
 /* Forward type declarations */
+typedef struct Buffer Buffer;
+typedef struct BufferSegment BufferSegment;
 typedef struct Creator Creator;
 typedef struct Descriptor Descriptor;
 typedef struct DescriptorBits DescriptorBits;
@@ -33,6 +35,7 @@ typedef struct User User;
  */
 struct DescriptorBits {
   uint8_t               color: 1;       /*!< Descriptor has color enabled */
+  uint8_t               pending: 1;     /*!< Descriptor is in the pending list */
   uint8_t               prompt: 1;      /*!< Descriptor needs prompt */
   uint8_t               sb: 1;          /*!< Descriptor received telnet SB */
 };
@@ -53,8 +56,7 @@ struct Descriptor {
   size_t                inputN;         /*!< The input buffer used */
   uint16_t              lineLength;     /*!< The output line length */
   char                 *name;           /*!< The descriptor name */
-  char                  output[MAXLEN_OUTPUT]; /*!< The output buffer */
-  size_t                outputN;        /*!< The output buffer used */
+  Buffer               *output;         /*!< The output buffer */
   char                  sb[MAXLEN_INPUT];      /*!< The telnet SB input buffer */
   size_t                sbN;            /*!< The telnet SB input buffer used */
   Socket               *socket;         /*!< The descriptor socket */
@@ -141,6 +143,14 @@ void DescriptorPrint(
 	const char *format, ...)
 	__attribute__ ((format (printf, 2, 3)));
 
+/*!
+ * Schedules a descriptor to be flushed, or deleted if closed,
+ * at the end of the current poll.
+ * \addtogroup descriptor
+ * \param d the descriptor to schedule
+ */
+void DescriptorSchedule(Descriptor *d);
+
 /*!
  * Sends a TELNET command.
  * \addtogroup descriptor
@@ -153,6 +163,17 @@ void DescriptorPutCommand(
 	const uint8_t telnetCommand,
 	const uint8_t telnetOption);
 
+/*!
+ * Sends a shared message segment.
+ * \addtogroup descriptor
+ * \param d the descriptor to which to send
+ * \param segment the rendered message segment to share
+ * \sa GameBroadcast(Game*, const GameRenderFunc, const void*)
+ */
+void DescriptorPutSegment(
+	Descriptor *d,
+	BufferSegment *segment);
+
 /*!
  * Sends the descriptor prompt.
  * \addtogroup descriptor
@@ -14,17 +14,32 @@
 #include <scratch/scratch.h>
 
 /* Forward type declarations */
+typedef struct Config Config;
+typedef struct Descriptor Descriptor;
 typedef struct Game Game;
+typedef struct List List;
+typedef struct Poller Poller;
+typedef struct Resolver Resolver;
 typedef struct Socket Socket;
 typedef struct Tree Tree;
 
+/*! The type of a broadcast message rendering function. */
+typedef void (*GameRenderFunc)(
+	const Descriptor *d,
+	char *messg, const size_t messglen,
+	const void *userData);
+
 /*!
  * The game state.
  * \addtogroup game
  * \{
  */
 struct Game {
+  Config               *config;         /*!< The game configuration */
   Tree                 *descriptors;    /*!< The descriptor index */
+  List                 *pending;        /*!< The descriptors to flush or delete */
+  Poller               *poller;         /*!< The network event poller */
+  Resolver             *resolver;       /*!< The hostname resolver */
   bool                  shutdown;       /*!< The shutdown flag */
   Socket               *socket;         /*!< The control socket */
   Tree                 *states;         /*!< The state index */
@@ -39,6 +54,20 @@ struct Game {
  */
 void GameAccept(Game *game);
 
+/*!
+ * Broadcasts a message to every open descriptor.  The message is
+ * rendered once per color mode, for the first recipient in that
+ * mode, and the rendered segment is shared by all recipients.
+ * \addtogroup game
+ * \param game the game state
+ * \param render the function to render the message
+ * \param userData the user-specified data to pass to \p render
+ */
+void GameBroadcast(
+	Game *game,
+	const GameRenderFunc render,
+	const void *userData);
+
 /*!
  * Constructs a new game state.
  * \addtogroup game
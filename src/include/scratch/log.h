@@ -18,35 +18,172 @@
  * \addtogroup log
  * \{
  */
-#define L_ASSERT	"Assert"	/*!< Code assertion. */
-#define L_DATA		"Data"		/*!< Data-related messages. */
-#define L_MAIN		"Main"		/*!< Program entry point. */
-#define L_NETWORK	"Network"	/*!< Network server messages */
-#define L_STATE		"State"		/*!< Connection state messages */
-#define L_SYSTEM	"System"	/*!< System errors, status, etc. */
-#define L_USER		"User"		/*!< User messages */
+#define L_ASSERT	(0)		/*!< Code assertion. */
+#define L_DATA		(1)		/*!< Data-related messages. */
+#define L_MAIN		(2)		/*!< Program entry point. */
+#define L_NETWORK	(3)		/*!< Network server messages */
+#define L_STATE		(4)		/*!< Connection state messages */
+#define L_SYSTEM	(5)		/*!< System errors, status, etc. */
+#define L_USER		(6)		/*!< User messages */
+#define L_MAX		(7)		/*!< The number of log types */
 /*! \} */
 
 /*!
- * Emits a log message.
+ * The log levels.
+ * \addtogroup log
+ * \{
+ */
+#define LOG_TRACE	(0)		/*!< Per-byte and per-command traces */
+#define LOG_DEBUG	(1)		/*!< Diagnostic messages */
+#define LOG_INFO	(2)		/*!< Normal operation */
+#define LOG_WARN	(3)		/*!< Recoverable problems */
+#define LOG_ERROR	(4)		/*!< Failures and assertions */
+/*! \} */
+
+/*!
+ * The lowest log level compiled in.  Log messages below this level
+ * compile to nothing; see the configure option --with-log-level.
+ * \addtogroup log
+ */
+#ifndef LOG_THRESHOLD
+#define LOG_THRESHOLD	LOG_TRACE
+#endif /* LOG_THRESHOLD */
+
+/*!
+ * The log backpressure policies.
+ * \addtogroup log
+ * \{
+ */
+#define LOG_BLOCK	(0)		/*!< Wait for the log writer */
+#define LOG_DROP	(1)		/*!< Drop and count the message */
+/*! \} */
+
+/*! The lowest log level emitted for each log type. */
+extern int g_logLevels[L_MAX];
+
+/*!
+ * Emits a log message if its level is compiled in and enabled for its
+ * log type.  The message arguments aren't evaluated otherwise.
+ * \addtogroup log
+ * \param level the log level: LOG_x
+ * \param type the log message type: L_x
+ */
+#define LogAt(level, type, ...) \
+  do { \
+    if ((level) >= LOG_THRESHOLD && (level) >= g_logLevels[(type)]) \
+      RealLog(__FILE__, __LINE__, (level), (type), __VA_ARGS__); \
+  } while (0)
+
+/*!
+ * Emits a log message.  Assertions and system failures are logged at
+ * LOG_ERROR and everything else at LOG_INFO.
  * \addtogroup log
- * \param type the log message type
+ * \param type the log message type: L_x
  */
 #define Log(type, ...) \
-  RealLog(__FILE__, __LINE__, type, __VA_ARGS__)
+  LogAt((type) == L_ASSERT || (type) == L_SYSTEM ? LOG_ERROR : LOG_INFO, type, __VA_ARGS__)
+
+/*!
+ * Emits a leveled log message.
+ * \addtogroup log
+ * \param type the log message type: L_x
+ * \{
+ */
+#if LOG_THRESHOLD <= LOG_TRACE
+#define LogTrace(type, ...)	LogAt(LOG_TRACE, type, __VA_ARGS__)
+#else
+#define LogTrace(type, ...)	do { } while (0)
+#endif /* LOG_THRESHOLD <= LOG_TRACE */
+
+#if LOG_THRESHOLD <= LOG_DEBUG
+#define LogDebug(type, ...)	LogAt(LOG_DEBUG, type, __VA_ARGS__)
+#else
+#define LogDebug(type, ...)	do { } while (0)
+#endif /* LOG_THRESHOLD <= LOG_DEBUG */
+
+#if LOG_THRESHOLD <= LOG_INFO
+#define LogInfo(type, ...)	LogAt(LOG_INFO, type, __VA_ARGS__)
+#else
+#define LogInfo(type, ...)	do { } while (0)
+#endif /* LOG_THRESHOLD <= LOG_INFO */
+
+#if LOG_THRESHOLD <= LOG_WARN
+#define LogWarn(type, ...)	LogAt(LOG_WARN, type, __VA_ARGS__)
+#else
+#define LogWarn(type, ...)	do { } while (0)
+#endif /* LOG_THRESHOLD <= LOG_WARN */
+
+#define LogError(type, ...)	LogAt(LOG_ERROR, type, __VA_ARGS__)
+/*! \} */
+
+/*!
+ * Stops the log writer after writing every queued log message.
+ * \addtogroup log
+ * \sa LogStartup()
+ */
+void LogCleanup(void);
+
+/*!
+ * Blocks until every queued log message has been written.
+ * \addtogroup log
+ */
+void LogFlush(void);
+
+/*!
+ * Looks up a log level by name.
+ * \addtogroup log
+ * \param name the log level name: trace, debug, info, warn, or error
+ * \return the LOG_x log level, or -1 if the name is unknown
+ */
+int LogLevelByName(const char *name);
+
+/*!
+ * Sets the lowest log level emitted for a log type.
+ * \addtogroup log
+ * \param type the log message type: L_x
+ * \param level the log level: LOG_x
+ */
+void LogSetLevel(
+	const int type,
+	const int level);
+
+/*!
+ * Sets the log backpressure policy.
+ * \addtogroup log
+ * \param policy the policy to apply when the log queue is full: LOG_x
+ */
+void LogSetPolicy(const int policy);
+
+/*!
+ * Returns the name of a log type.
+ * \addtogroup log
+ * \param type the log message type: L_x
+ * \return the name of the specified log type, e.g. "Network"
+ */
+const char *LogTypeName(const int type);
+
+/*!
+ * Starts the log writer.  Until it starts, and after it stops,
+ * log messages are written synchronously.
+ * \addtogroup log
+ * \sa LogCleanup()
+ */
+void LogStartup(void);
 
 /*!
  * Emits a log message.
  * \addtogroup log
  * \param fileName the filename to write to the log file
  * \param fileLine the line number to write to the log file
- * \param type the log message type
+ * \param level the log level: LOG_x
+ * \param type the log message type: L_x
  * \param format the prinft-style format specifier
  */
 void RealLog(
 	const char *fileName,
 	const int fileLine,
-	const char *type,
+	const int level,
+	const int type,
 	const char *format, ...);
 
 #endif /* _SCRATCH_LOG_H_ */
@@ -0,0 +1,181 @@
+/*!
+ * \file poller.h
+ *
+ * \par Copyright
+ * Copyright (C) 1999-2023 scratchmud.org
+ * All rights reserved.
+ *
+ * \author Geoffrey Davis <gdavis@scratchmud.org>
+ * \addtogroup poller
+ */
+#ifndef _SCRATCH_POLLER_H_
+#define _SCRATCH_POLLER_H_
+
+#include <scratch/scratch.h>
+
+/*!
+ * The poller event bits.
+ * \addtogroup poller
+ * \{
+ */
+#define POLLER_READ	(1 << 0)	/*!< Socket is readable */
+#define POLLER_WRITE	(1 << 1)	/*!< Socket is writable */
+#define POLLER_ERROR	(1 << 2)	/*!< Socket has an error or hang-up */
+#define POLLER_EDGE	(1 << 3)	/*!< Report readiness changes only */
+/*! \} */
+
+/* Forward type declarations */
+typedef struct Poller Poller;
+typedef struct PollerBackend PollerBackend;
+typedef struct PollerEvent PollerEvent;
+typedef struct PollerWatch PollerWatch;
+typedef struct Socket Socket;
+
+/*!
+ * The poller backend structure.
+ * \addtogroup poller
+ * \{
+ */
+struct PollerBackend {
+  const char           *name;           /*!< The backend name */
+  bool                (*open)(Poller *poller);
+  void                (*close)(Poller *poller);
+  bool                (*watch)(Poller *poller, const PollerWatch *watch, const int lastEvents);
+  int                 (*wait)(Poller *poller, Time *timeout);
+};
+/*! \} */
+
+/*!
+ * The poller event structure.
+ * \addtogroup poller
+ * \{
+ */
+struct PollerEvent {
+  int                   events;         /*!< The ready events: POLLER_x */
+  SOCKET                handle;         /*!< The OS socket handle */
+  void                 *userData;       /*!< The user-specified data */
+};
+/*! \} */
+
+/*!
+ * The poller watch structure.
+ * \addtogroup poller
+ * \{
+ */
+struct PollerWatch {
+  int                   events;         /*!< The watched events: POLLER_x */
+  SOCKET                handle;         /*!< The OS socket handle */
+  void                 *userData;       /*!< The user-specified data */
+};
+/*! \} */
+
+/*!
+ * The poller structure.
+ * \addtogroup poller
+ * \{
+ */
+struct Poller {
+  const PollerBackend  *backend;        /*!< The poller backend */
+  void                 *backendData;    /*!< The backend event buffer */
+  PollerEvent          *events;         /*!< The ready events */
+  size_t                eventsMax;      /*!< The ready events allocated */
+  size_t                eventsN;        /*!< The ready events used */
+  SOCKET                handle;         /*!< The backend OS handle */
+  PollerWatch          *watches;        /*!< The watches, indexed by handle */
+  size_t                watchesMax;     /*!< The watches allocated */
+  size_t                watchesN;       /*!< The watches used */
+};
+/*! \} */
+
+/*!
+ * Watches a socket.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param socket the socket to watch
+ * \param events the events to watch: POLLER_x
+ * \param userData the user-specified data to report with events
+ * \return true if the specified socket is now watched
+ * \sa PollerRemove(Poller*, Socket*)
+ */
+bool PollerAdd(
+	Poller *poller,
+	Socket *socket,
+	const int events,
+	void *userData);
+
+/*!
+ * Constructs a new poller.
+ * \addtogroup poller
+ * \param backendName the poller backend name or NULL for the default
+ * \return the new poller or NULL
+ * \sa PollerFree(Poller*)
+ * \sa PollerFreeV(void*)
+ */
+Poller *PollerAlloc(const char *backendName);
+
+/*!
+ * Iterates over the ready events.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param cursor the name of the iterator variable
+ */
+#define PollerForEach(poller, cursor) \
+  for (PollerEvent *cursor = (poller) ? (poller)->events : NULL; \
+		  cursor && cursor < (poller)->events + (poller)->eventsN; ++cursor)
+
+/*!
+ * Frees a poller.
+ * \addtogroup poller
+ * \param poller the poller to free
+ * \sa PollerAlloc(const char*)
+ * \sa PollerFreeV(void*)
+ */
+void PollerFree(Poller *poller);
+
+/*!
+ * Frees a poller.
+ * \addtogroup poller
+ * \param poller the poller to free
+ * \sa PollerAlloc(const char*)
+ * \sa PollerFree(Poller*)
+ */
+void PollerFreeV(void *poller);
+
+/*!
+ * Changes the watched events of a socket.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param socket the watched socket
+ * \param events the events to watch: POLLER_x
+ * \return true if the watched events were successfully changed
+ */
+bool PollerModify(
+	Poller *poller,
+	Socket *socket,
+	const int events);
+
+/*!
+ * Stops watching a socket.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param socket the socket to stop watching
+ * \sa PollerAdd(Poller*, Socket*, const int, void*)
+ */
+void PollerRemove(
+	Poller *poller,
+	Socket *socket);
+
+/*!
+ * Waits for network events.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param timeout the interval for which this function should block
+ *     waiting for a watched socket to become ready, or NULL to wait
+ *     indefinitely
+ * \return the number of ready events, or -1
+ */
+int PollerWait(
+	Poller *poller,
+	Time *timeout);
+
+#endif /* _SCRATCH_POLLER_H_ */
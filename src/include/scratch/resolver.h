@@ -0,0 +1,206 @@
+/*!
+ * \file resolver.h
+ *
+ * \par Copyright
+ * Copyright (C) 1999-2023 scratchmud.org
+ * All rights reserved.
+ *
+ * \author Geoffrey Davis <gdavis@scratchmud.org>
+ * \addtogroup resolver
+ */
+#ifndef _SCRATCH_RESOLVER_H_
+#define _SCRATCH_RESOLVER_H_
+
+#include <scratch/scratch.h>
+
+/* Forward type declarations */
+typedef struct Resolver Resolver;
+typedef struct ResolverEntry ResolverEntry;
+typedef struct ResolverRequest ResolverRequest;
+typedef struct Socket Socket;
+
+/*!
+ * The default maximum number of cached hostnames.
+ * \addtogroup resolver
+ */
+#define RESOLVER_CACHEMAX	(1024)
+
+/*!
+ * The largest configurable number of cached hostnames.
+ * \addtogroup resolver
+ */
+#define RESOLVER_CACHEMAX_LIMIT	(1024 * 1024)
+
+/*!
+ * The default number of seconds for which hostnames are cached.
+ * \addtogroup resolver
+ */
+#define RESOLVER_CACHETTL	(3600)
+
+/*!
+ * The default number of resolver worker threads.
+ * \addtogroup resolver
+ */
+#define RESOLVER_WORKERS	(2)
+
+/*!
+ * The largest configurable number of resolver worker threads.
+ * \addtogroup resolver
+ */
+#define RESOLVER_WORKERS_LIMIT	(64)
+
+/*! The type of a hostname resolution function. */
+typedef bool (*ResolverFunc)(
+	const SOCKADDR *address,
+	const socklen_t addressSZ,
+	char *hostname, const size_t hostnamelen);
+
+/*! The type of a resolved hostname notification function. */
+typedef void (*ResolverDoneFunc)(
+	const char *key,
+	const char *numeric,
+	const char *hostname,
+	void *userData);
+
+/*!
+ * The resolver cache entry structure.
+ * \addtogroup resolver
+ * \{
+ */
+struct ResolverEntry {
+  char                 *address;        /*!< The numeric address */
+  time_t                expires;        /*!< The time at which the entry expires */
+  char                 *hostname;       /*!< The resolved hostname */
+  ResolverEntry        *lruNext;        /*!< The next less recently used entry */
+  ResolverEntry        *lruPrev;        /*!< The next more recently used entry */
+  ResolverEntry        *next;           /*!< The next entry in the hash bucket */
+};
+/*! \} */
+
+/*!
+ * The resolver request structure.
+ * \addtogroup resolver
+ * \{
+ */
+struct ResolverRequest {
+  SOCKADDR              address;        /*!< The address to resolve */
+  socklen_t             addressSZ;      /*!< The address length */
+  char                 *hostname;       /*!< The resolved hostname or NULL */
+  char                 *key;            /*!< The requester key */
+  ResolverRequest      *next;           /*!< The next request */
+  char                 *numeric;        /*!< The numeric address */
+};
+/*! \} */
+
+/*!
+ * The resolver structure.
+ * \addtogroup resolver
+ * \{
+ */
+struct Resolver {
+  ResolverEntry       **buckets;        /*!< The cache hash buckets */
+  size_t                bucketsN;       /*!< The cache hash buckets allocated */
+  size_t                cacheMax;       /*!< The maximum cache size */
+  size_t                cacheN;         /*!< The cache size */
+  time_t                cacheTtl;       /*!< The cache entry lifetime in seconds */
+  ResolverRequest      *done;           /*!< The resolved requests */
+  size_t                hits;           /*!< The cache hits */
+  ResolverEntry        *lruBack;        /*!< The least recently used entry */
+  ResolverEntry        *lruFront;       /*!< The most recently used entry */
+  size_t                misses;         /*!< The cache misses */
+  ResolverRequest      *pending;        /*!< The requests awaiting a worker */
+  ResolverRequest      *pendingBack;    /*!< The last request awaiting a worker */
+  ResolverFunc          resolve;        /*!< The hostname resolution function */
+  Socket               *wakeup;         /*!< The readable end of the wakeup pipe */
+  int                   wakeupWriter;   /*!< The writable end of the wakeup pipe */
+  size_t                workersN;       /*!< The number of worker threads */
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_t       lock;           /*!< The request queue lock */
+  bool                  running;        /*!< The worker threads are running */
+  pthread_cond_t        signal;         /*!< Signalled as requests are queued */
+  pthread_t            *workers;        /*!< The worker threads */
+#endif /* HAVE_PTHREAD_H */
+};
+/*! \} */
+
+/*!
+ * Constructs a new resolver.
+ * \addtogroup resolver
+ * \param workersN the number of worker threads, or zero to disable
+ *     hostname resolution
+ * \param cacheMax the maximum number of cached hostnames
+ * \param cacheTtl the number of seconds for which hostnames are cached
+ * \param resolve the hostname resolution function, or NULL for the
+ *     default, which uses getnameinfo()
+ * \return the new resolver or NULL
+ * \sa ResolverFree(Resolver*)
+ * \sa ResolverFreeV(void*)
+ */
+Resolver *ResolverAlloc(
+	const size_t workersN,
+	const size_t cacheMax,
+	const time_t cacheTtl,
+	const ResolverFunc resolve);
+
+/*!
+ * Frees a resolver.
+ * \addtogroup resolver
+ * \param resolver the resolver to free
+ * \sa ResolverAlloc(const size_t, const size_t, const time_t, const ResolverFunc)
+ * \sa ResolverFreeV(void*)
+ */
+void ResolverFree(Resolver *resolver);
+
+/*!
+ * Frees a resolver.
+ * \addtogroup resolver
+ * \param resolver the resolver to free
+ * \sa ResolverAlloc(const size_t, const size_t, const time_t, const ResolverFunc)
+ * \sa ResolverFree(Resolver*)
+ */
+void ResolverFreeV(void *resolver);
+
+/*!
+ * Returns a cached hostname.
+ * \addtogroup resolver
+ * \param resolver the resolver
+ * \param numeric the numeric address whose hostname to return
+ * \return the cached hostname for the specified address, or NULL
+ */
+const char *ResolverGet(
+	Resolver *resolver,
+	const char *numeric);
+
+/*!
+ * Delivers resolved hostnames.  Call when the wakeup socket
+ * becomes readable.
+ * \addtogroup resolver
+ * \param resolver the resolver
+ * \param done the function to call for each resolved hostname
+ * \param userData the user-specified data to pass to \p done
+ * \return the number of resolved hostnames delivered
+ */
+size_t ResolverPoll(
+	Resolver *resolver,
+	const ResolverDoneFunc done,
+	void *userData);
+
+/*!
+ * Queues a hostname lookup.
+ * \addtogroup resolver
+ * \param resolver the resolver
+ * \param key the requester key to deliver with the hostname
+ * \param address the address to resolve
+ * \param addressSZ the length of the specified address
+ * \param numeric the numeric form of the specified address
+ * \return true if the lookup was queued
+ * \sa ResolverPoll(Resolver*, const ResolverDoneFunc, void*)
+ */
+bool ResolverQueue(
+	Resolver *resolver,
+	const char *key,
+	const SOCKADDR *address,
+	const socklen_t addressSZ,
+	const char *numeric);
+
+#endif /* _SCRATCH_RESOLVER_H_ */
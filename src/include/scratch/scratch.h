@@ -69,10 +69,18 @@
 #include <netinet/in.h>
 #endif /* HAVE_NET_INET_H */
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif /* HAVE_PTHREAD_H */
+
 #ifdef HAVE_STDARG_H
 #include <stdarg.h>
 #endif /* HAVE_STDARG_H */
 
+#ifdef HAVE_STDATOMIC_H
+#include <stdatomic.h>
+#endif /* HAVE_STDATOMIC_H */
+
 #ifdef HAVE_STDBOOL_H
 #include <stdbool.h>
 #endif /* HAVE_STDBOOL_H */
@@ -95,6 +103,10 @@
 #include <strings.h>
 #endif /* HAVE_STRING_H */
 
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif /* HAVE_SYS_RESOURCE_H */
+
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif /* HAVE_SYS_SOCKET_H */
@@ -111,6 +123,10 @@
 #include <sys/types.h>
 #endif /* HAVE_SYS_TYPES_H */
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif /* HAVE_SYS_UIO_H */
+
 #ifdef HAVE_TIME_H
 #include <time.h>
 #endif /* HAVE_TIME_H */
@@ -126,7 +126,8 @@ bool SocketOpen(
  * \param socket the socket from which to read
  * \param messg the message buffer
  * \param messglen the length of the specified buffer
- * \return the number of bytes read from the network stream, or -1
+ * \return the number of bytes read from the network stream, zero if
+ *     no data is available, or -1 on error or end of stream
  * \sa SocketWrite(Socket*, const void*, const size_t)
  */
 ssize_t SocketRead(
@@ -153,4 +154,19 @@ ssize_t SocketWrite(
 	Socket *socket,
 	const void *messg, const size_t messglen);
 
+#ifdef HAVE_SYS_UIO_H
+/*!
+ * Writes to a socket from several buffers at once.
+ * \addtogroup socket
+ * \param socket the socket to which to write
+ * \param iov the message buffers
+ * \param iovN the number of message buffers
+ * \return the number of bytes written to the network stream, or -1
+ * \sa SocketWrite(Socket*, const void*, const size_t)
+ */
+ssize_t SocketWriteVector(
+	Socket *socket,
+	const struct iovec *iov, const size_t iovN);
+#endif /* HAVE_SYS_UIO_H */
+
 #endif /* _SCRATCH_SOCKET_H_ */
@@ -0,0 +1,327 @@
+/*!
+ * \file buffer.c
+ *
+ * \par Copyright
+ * Copyright (C) 1999-2023 scratchmud.org
+ * All rights reserved.
+ *
+ * \author Geoffrey Davis <gdavis@scratchmud.org>
+ * \addtogroup buffer
+ */
+#define _SCRATCH_BUFFER_C_
+
+#include <scratch/buffer.h>
+#include <scratch/log.h>
+#include <scratch/memory.h>
+#include <scratch/scratch.h>
+#include <scratch/socket.h>
+
+/*! The maximum number of slices written at once. */
+#define BUFFER_IOVMAX		(64)
+
+/*!
+ * Constructs a new buffer.
+ * \addtogroup buffer
+ * \param limit the maximum unwritten buffer length, or zero for no
+ *     limit
+ * \return the new buffer or NULL
+ * \sa BufferFree(Buffer*)
+ * \sa BufferFreeV(void*)
+ */
+Buffer *BufferAlloc(const size_t limit) {
+  Buffer *buffer;
+  MemoryCreate(buffer, Buffer, 1);
+  buffer->length = 0;
+  buffer->limit = limit;
+  buffer->slices = NULL;
+  buffer->slicesFront = 0;
+  buffer->slicesMax = 0;
+  buffer->slicesN = 0;
+  return (buffer);
+}
+
+/* Buffer helper function. */
+static BufferSlice *BufferSliceAt(
+	Buffer *buffer,
+	const size_t index) {
+  return &buffer->slices[(buffer->slicesFront + index) % buffer->slicesMax];
+}
+
+/* Buffer helper function. */
+static BufferSlice *BufferSlicePush(
+	Buffer *buffer,
+	BufferSegment *segment) {
+  /* Grow slice ring */
+  if (buffer->slicesN == buffer->slicesMax) {
+    const size_t slicesMax = buffer->slicesMax ? buffer->slicesMax * 2 : 4;
+    BufferSlice *slices;
+    MemoryCreate(slices, BufferSlice, slicesMax);
+    register size_t i;
+    for (i = 0; i < buffer->slicesN; ++i)
+      slices[i] = *BufferSliceAt(buffer, i);
+    MemoryFree(buffer->slices);
+    buffer->slices = slices;
+    buffer->slicesFront = 0;
+    buffer->slicesMax = slicesMax;
+  }
+
+  /* Link slice */
+  BufferSlice *slice = BufferSliceAt(buffer, buffer->slicesN++);
+  slice->length = 0;
+  slice->offset = segment->length;
+  slice->segment = segment;
+  return (slice);
+}
+
+/*!
+ * Appends to a buffer.
+ * \addtogroup buffer
+ * \param buffer the buffer to which to append
+ * \param messg the message buffer
+ * \param messglen the length of the specified message buffer
+ * \return true if the message was appended, or false if appending
+ *     it would exceed the buffer limit
+ */
+bool BufferAppend(
+	Buffer *buffer,
+	const void *messg, const size_t messglen) {
+  register bool result = false;
+  if (!buffer) {
+    Log(L_ASSERT, "Invalid `buffer` Buffer.");
+  } else if (!messg && messglen) {
+    Log(L_ASSERT, "Invalid `messg` buffer.");
+  } else if (buffer->limit && buffer->length + messglen > buffer->limit) {
+    result = false;
+  } else {
+    register const char *p = messg;
+    register size_t remaining = messglen;
+    while (remaining) {
+      /* Fill the tail of the last unshared segment, or start a new one */
+      BufferSlice *slice = buffer->slicesN ?
+	BufferSliceAt(buffer, buffer->slicesN - 1) : NULL;
+      if (!slice || slice->segment->refs > 1 ||
+	   slice->offset + slice->length != slice->segment->length ||
+	   slice->segment->length == slice->segment->capacity) {
+	slice = BufferSlicePush(buffer, BufferSegmentAlloc(NULL, MAXLEN_SEGMENT));
+      }
+
+      BufferSegment *segment = slice->segment;
+      register size_t n = segment->capacity - segment->length;
+      if (n > remaining)
+	n = remaining;
+
+      MemoryCopy(segment->data + segment->length, p, char, n);
+      segment->length += n;
+      slice->length += n;
+      buffer->length += n;
+      remaining -= n;
+      p += n;
+    }
+    result = true;
+  }
+  return (result);
+}
+
+/*!
+ * Appends a shared segment to a buffer without copying it.
+ * \addtogroup buffer
+ * \param buffer the buffer to which to append
+ * \param segment the segment to append
+ * \return true if the segment was appended, or false if appending
+ *     it would exceed the buffer limit
+ */
+bool BufferAppendSegment(
+	Buffer *buffer,
+	BufferSegment *segment) {
+  register bool result = false;
+  if (!buffer) {
+    Log(L_ASSERT, "Invalid `buffer` Buffer.");
+  } else if (!segment) {
+    Log(L_ASSERT, "Invalid `segment` BufferSegment.");
+  } else if (buffer->limit && buffer->length + segment->length > buffer->limit) {
+    result = false;
+  } else {
+    if (segment->length) {
+      BufferSlice *slice = BufferSlicePush(buffer, segment);
+      slice->length = segment->length;
+      slice->offset = 0;
+      buffer->length += segment->length;
+      segment->refs++;
+    }
+    result = true;
+  }
+  return (result);
+}
+
+/* Buffer helper function. */
+static void BufferConsume(
+	Buffer *buffer,
+	size_t nBytes) {
+  while (nBytes && buffer->slicesN) {
+    BufferSlice *slice = BufferSliceAt(buffer, 0);
+    if (nBytes < slice->length) {
+      /* Partially written slice */
+      slice->offset += nBytes;
+      slice->length -= nBytes;
+      buffer->length -= nBytes;
+      nBytes = 0;
+    } else {
+      /* Fully written slice */
+      nBytes -= slice->length;
+      buffer->length -= slice->length;
+      BufferSegmentFree(slice->segment);
+      buffer->slicesFront = (buffer->slicesFront + 1) % buffer->slicesMax;
+      buffer->slicesN--;
+    }
+  }
+}
+
+/*!
+ * Clears a buffer.
+ * \addtogroup buffer
+ * \param buffer the buffer to clear
+ */
+void BufferClear(Buffer *buffer) {
+  if (!buffer) {
+    Log(L_ASSERT, "Invalid `buffer` Buffer.");
+  } else {
+    while (buffer->slicesN)
+      BufferConsume(buffer, BufferSliceAt(buffer, 0)->length);
+    buffer->length = 0;
+    buffer->slicesFront = 0;
+  }
+}
+
+/*!
+ * Frees a buffer.
+ * \addtogroup buffer
+ * \param buffer the buffer to free
+ * \sa BufferAlloc(const size_t)
+ * \sa BufferFreeV(void*)
+ */
+void BufferFree(Buffer *buffer) {
+  if (buffer) {
+    BufferClear(buffer);
+    MemoryFree(buffer->slices);
+    MemoryFree(buffer);
+  }
+}
+
+/*!
+ * Frees a buffer.
+ * \addtogroup buffer
+ * \param buffer the buffer to free
+ * \sa BufferAlloc(const size_t)
+ * \sa BufferFree(Buffer*)
+ */
+void BufferFreeV(void *buffer) {
+  BufferFree(buffer);
+}
+
+/*!
+ * Constructs a new buffer segment.
+ * \addtogroup buffer
+ * \param messg the message buffer, or NULL for an empty segment
+ * \param messglen the length of the specified message buffer, or the
+ *     capacity of the empty segment
+ * \return the new buffer segment, holding one reference
+ * \sa BufferSegmentFree(BufferSegment*)
+ */
+BufferSegment *BufferSegmentAlloc(
+	const void *messg, const size_t messglen) {
+  BufferSegment *segment;
+  MemoryCreate(segment, BufferSegment, 1);
+  MemoryCreate(segment->data, char, messglen);
+  segment->capacity = messglen;
+  segment->length = 0;
+  segment->refs = 1;
+  if (messg) {
+    MemoryCopy(segment->data, messg, char, messglen);
+    segment->length = messglen;
+  }
+  return (segment);
+}
+
+/*!
+ * Releases a reference to a buffer segment, freeing it with
+ * the last reference.
+ * \addtogroup buffer
+ * \param segment the buffer segment to release
+ * \sa BufferSegmentAlloc(const void*, const size_t)
+ */
+void BufferSegmentFree(BufferSegment *segment) {
+  if (segment && --segment->refs == 0) {
+    MemoryFree(segment->data);
+    MemoryFree(segment);
+  }
+}
+
+/* Buffer helper function. */
+static ssize_t BufferWriteOnce(
+	Buffer *buffer,
+	Socket *socket,
+	size_t *wanted) {
+#ifdef HAVE_SYS_UIO_H
+  /* Gather unwritten slices */
+  struct iovec iov[BUFFER_IOVMAX];
+  register size_t i, iovN = 0;
+  *wanted = 0;
+  for (i = 0; i < buffer->slicesN && iovN < BUFFER_IOVMAX; ++i) {
+    BufferSlice *slice = BufferSliceAt(buffer, i);
+    if (slice->length) {
+      iov[iovN].iov_base = slice->segment->data + slice->offset;
+      iov[iovN].iov_len = slice->length;
+      *wanted += slice->length;
+      iovN++;
+    }
+  }
+
+  /* Write to network stream */
+  return SocketWriteVector(socket, iov, iovN);
+#else
+  /* Write first slice to network stream */
+  BufferSlice *slice = BufferSliceAt(buffer, 0);
+  *wanted = slice->length;
+  return SocketWrite(socket,
+	slice->segment->data + slice->offset, slice->length);
+#endif /* HAVE_SYS_UIO_H */
+}
+
+/*!
+ * Writes a buffer to a socket until the buffer is empty or the
+ * socket would block.
+ * \addtogroup buffer
+ * \param buffer the buffer to write
+ * \param socket the socket to which to write
+ * \return the number of bytes written to the network stream, or -1
+ */
+ssize_t BufferWrite(
+	Buffer *buffer,
+	Socket *socket) {
+  register ssize_t result = -1;
+  if (!buffer) {
+    Log(L_ASSERT, "Invalid `buffer` Buffer.");
+  } else if (!socket) {
+    Log(L_ASSERT, "Invalid `socket` Socket.");
+  } else {
+    result = 0;
+    while (buffer->length) {
+      size_t wanted = 0;
+      const ssize_t nBytes = BufferWriteOnce(buffer, socket, &wanted);
+
+      if (nBytes < 0) {
+	result = -1;
+	break;
+      }
+
+      /* Release written slices */
+      BufferConsume(buffer, nBytes);
+      result += nBytes;
+
+      /* Stop once the socket is full */
+      if ((size_t) nBytes < wanted)
+	break;
+    }
+  }
+  return (result);
+}
@@ -0,0 +1,215 @@
+/*!
+ * \file config.c
+ *
+ * \par Copyright
+ * Copyright (C) 1999-2023 scratchmud.org
+ * All rights reserved.
+ *
+ * \author Geoffrey Davis <gdavis@scratchmud.org>
+ * \addtogroup config
+ */
+#define _SCRATCH_CONFIG_C_
+
+#include <scratch/config.h>
+#include <scratch/data.h>
+#include <scratch/descriptor.h>
+#include <scratch/game.h>
+#include <scratch/log.h>
+#include <scratch/memory.h>
+#include <scratch/resolver.h>
+#include <scratch/scratch.h>
+#include <scratch/string.h>
+
+/*!
+ * Constructs a new game configuration.
+ * \addtogroup config
+ * \return the new game configuration with default settings
+ * \sa ConfigFree(Config*)
+ * \sa ConfigFreeV(void*)
+ */
+Config *ConfigAlloc(void) {
+  Config *config;
+  MemoryCreate(config, Config, 1);
+  register size_t i;
+  for (i = 0; i < L_MAX; ++i)
+    config->logLevels[i] = LOG_INFO;
+  config->logPolicy = LOG_BLOCK;
+  config->outputLimit = MAXLEN_OUTPUT;
+  config->poller = NULL;
+  config->resolverCacheMax = RESOLVER_CACHEMAX;
+  config->resolverCacheTtl = RESOLVER_CACHETTL;
+  config->resolverWorkers = RESOLVER_WORKERS;
+  return (config);
+}
+
+/*!
+ * Frees a game configuration.
+ * \addtogroup config
+ * \param config the game configuration to free
+ * \sa ConfigAlloc()
+ * \sa ConfigFreeV(void*)
+ */
+void ConfigFree(Config *config) {
+  if (config) {
+    StringFree(config->poller);
+    MemoryFree(config);
+  }
+}
+
+/*!
+ * Frees a game configuration.
+ * \addtogroup config
+ * \param config the game configuration to free
+ * \sa ConfigAlloc()
+ * \sa ConfigFree(Config*)
+ */
+void ConfigFreeV(void *config) {
+  ConfigFree(config);
+}
+
+#define CONFIG_FILE		"data/config.dat"
+
+/*!
+ * Loads the game configuration.
+ * \addtogroup config
+ * \param game the game state
+ */
+void ConfigLoad(Game *game) {
+  if (!game) {
+    Log(L_ASSERT, "Invalid `game` Game.");
+  } else {
+    Data *root = DataLoadFile(CONFIG_FILE);
+    if (!root) {
+      Log(L_MAIN, "Couldn't load config file `%s`; using defaults.", CONFIG_FILE);
+    } else {
+      ConfigParse(root, game->config);
+      DataFree(root);
+    }
+    register size_t i;
+    for (i = 0; i < L_MAX; ++i)
+      LogSetLevel(i, game->config->logLevels[i]);
+    LogSetPolicy(game->config->logPolicy);
+  }
+}
+
+/*!
+ * Parses a game configuration.
+ * \addtogroup config
+ * \param fromData the data element to parse
+ * \param toConfig the location of the parsed game configuration
+ */
+static void ConfigParseLog(
+	Data *fromData,
+	Config *toConfig) {
+  if (!fromData) {
+    Log(L_ASSERT, "Invalid `fromData` Data.");
+  } else if (!toConfig) {
+    Log(L_ASSERT, "Invalid `toConfig` Config.");
+  } else {
+    Data *log = DataGet(fromData, "Log");
+
+    /* Log levels */
+    Data *levels = DataGet(log, "Levels");
+    register size_t i;
+    for (i = 0; i < L_MAX; ++i) {
+      const char *levelName = DataGetString(levels, LogTypeName(i), "info");
+      const int level = LogLevelByName(levelName);
+      if (level < 0) {
+	Log(L_MAIN, "Unknown log level `%s` for `%s`; using `info`.", levelName, LogTypeName(i));
+	toConfig->logLevels[i] = LOG_INFO;
+      } else {
+	toConfig->logLevels[i] = level;
+      }
+    }
+
+    /* Log policy */
+    const char *policy = DataGetString(log, "Policy", "block");
+    if (!StringCaseCompare(policy, "drop")) {
+      toConfig->logPolicy = LOG_DROP;
+    } else if (!StringCaseCompare(policy, "block")) {
+      toConfig->logPolicy = LOG_BLOCK;
+    } else {
+      Log(L_MAIN, "Unknown log policy `%s`; using `block`.", policy);
+      toConfig->logPolicy = LOG_BLOCK;
+    }
+  }
+}
+
+/* Config helper function. */
+static size_t ConfigGetSize(
+	Data *fromData,
+	const char *section,
+	const char *key,
+	const size_t minValue,
+	const size_t maxValue,
+	const size_t defaultValue) {
+  const double value = DataGetNumber(DataGet(fromData, section), key, defaultValue);
+
+  /* Out of range values, including NaN, fall back to the default */
+  if (!(value >= minValue && value <= maxValue)) {
+    Log(L_MAIN, "Invalid %s/%s value %g; using %zu.", section, key, value, defaultValue);
+    return (defaultValue);
+  }
+  return ((size_t) value);
+}
+
+/*!
+ * Parses a game configuration.
+ * \addtogroup config
+ * \param fromData the data element to parse
+ * \param toConfig the location of the parsed game configuration
+ */
+static void ConfigParseNetwork(
+	Data *fromData,
+	Config *toConfig) {
+  if (!fromData) {
+    Log(L_ASSERT, "Invalid `fromData` Data.");
+  } else if (!toConfig) {
+    Log(L_ASSERT, "Invalid `toConfig` Config.");
+  } else {
+    Data *network = DataGet(fromData, "Network");
+    toConfig->outputLimit = ConfigGetSize(fromData, "Network", "OutputLimit", 1, INT_MAX, MAXLEN_OUTPUT);
+    StringFree(toConfig->poller);
+    toConfig->poller = DataGetStringCopy(network, "Poller", NULL);
+  }
+}
+
+/*!
+ * Parses a game configuration.
+ * \addtogroup config
+ * \param fromData the data element to parse
+ * \param toConfig the location of the parsed game configuration
+ */
+static void ConfigParseResolver(
+	Data *fromData,
+	Config *toConfig) {
+  if (!fromData) {
+    Log(L_ASSERT, "Invalid `fromData` Data.");
+  } else if (!toConfig) {
+    Log(L_ASSERT, "Invalid `toConfig` Config.");
+  } else {
+    toConfig->resolverCacheMax = ConfigGetSize(fromData, "Resolver", "CacheSize", 0, RESOLVER_CACHEMAX_LIMIT, RESOLVER_CACHEMAX);
+    toConfig->resolverCacheTtl = ConfigGetSize(fromData, "Resolver", "CacheTtl", 0, INT_MAX, RESOLVER_CACHETTL);
+    toConfig->resolverWorkers = ConfigGetSize(fromData, "Resolver", "Workers", 0, RESOLVER_WORKERS_LIMIT, RESOLVER_WORKERS);
+  }
+}
+
+/*!
+ * Parses a game configuration.
+ * \addtogroup config
+ * \param fromData the data element to parse
+ * \param toConfig the location of the parsed game configuration
+ */
+void ConfigParse(
+	Data *fromData,
+	Config *toConfig) {
+  if (!fromData) {
+    Log(L_ASSERT, "Invalid `fromData` Data.");
+  } else if (!toConfig) {
+    Log(L_ASSERT, "Invalid `toConfig` Config.");
+  } else {
+    ConfigParseLog(fromData, toConfig);
+    ConfigParseNetwork(fromData, toConfig);
+    ConfigParseResolver(fromData, toConfig);
+  }
+}
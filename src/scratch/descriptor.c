@@ -13,13 +13,17 @@
 #define TELCMDS
 #define TELOPTS
 
+#include <scratch/buffer.h>
 #include <scratch/color.h>
+#include <scratch/config.h>
 #include <scratch/creator.h>
 #include <scratch/descriptor.h>
 #include <scratch/editor.h>
 #include <scratch/game.h>
+#include <scratch/list.h>
 #include <scratch/log.h>
 #include <scratch/memory.h>
+#include <scratch/poller.h>
 #include <scratch/scratch.h>
 #include <scratch/socket.h>
 #include <scratch/state.h>
@@ -55,6 +59,7 @@ Descriptor *DescriptorAlloc(Game *game) {
     MemoryZero(d->input, char, sizeof(d->input));
     MemoryZero(d->sb, char, sizeof(d->sb));
     d->bits.color = false;
+    d->bits.pending = false;
     d->bits.prompt = false;
     d->bits.sb = false;
     d->creator = NULL;
@@ -63,6 +68,7 @@ Descriptor *DescriptorAlloc(Game *game) {
     d->hostname = NULL;
     d->inputN = 0;
     d->name = NULL;
+    d->output = BufferAlloc(game->config->outputLimit);
     d->sbN = 0;
     d->socket = NULL;
     d->state = NULL;
@@ -134,8 +140,13 @@ void DescriptorClose(Descriptor *d) {
     StateChange(d, NULL);
 
     /* Socket cleanup */
-    SocketFree(d->socket);
-    d->socket = NULL;
+    if (d->socket) {
+      if (!SocketClosed(d->socket))
+	PollerRemove(d->game->poller, d->socket);
+      SocketFree(d->socket);
+      d->socket = NULL;
+      DescriptorSchedule(d);
+    }
   }
 }
 
@@ -169,23 +180,15 @@ void DescriptorFlush(Descriptor *d) {
     }
 
     /* Write buffered output */
-    const ssize_t nBytes = SocketWrite(
-	d->socket,
-	d->output, d->outputN);
+    const ssize_t nBytes = BufferWrite(d->output, d->socket);
 
     if (nBytes < 0) {
       Log(L_NETWORK, "Losing descriptor %s.", d->name);
       DescriptorClose(d);
-    } else if (nBytes > 0) {
-      /* Erase flushed output */
-      MemoryCopy(
-	d->output,
-	d->output + d->outputN,
-	uint8_t,
-	d->outputN - nBytes);
-
-      /* Adjust output size */
-      d->outputN -= nBytes;
+    } else {
+      /* Wait for writability only while output remains */
+      PollerModify(d->game->poller, d->socket,
+	POLLER_READ | POLLER_EDGE | (d->output->length ? POLLER_WRITE : 0));
     }
   }
 }
@@ -200,6 +203,9 @@ void DescriptorFlush(Descriptor *d) {
 void DescriptorFree(Descriptor *d) {
   if (d) {
     DescriptorClose(d);
+    if (d->bits.pending)
+      ListRemoveNoFree(d->game->pending, d);
+    BufferFree(d->output);
     StringFree(d->hostname);
     StringFree(d->name);
     MemoryFree(d);
@@ -217,6 +223,43 @@ void DescriptorFreeV(void *d) {
   DescriptorFree(d);
 }
 
+/* Descriptor helper function. */
+static bool DescriptorPutInterrupt(Descriptor *d) {
+  register bool result = true;
+  if (!d->bits.prompt && !d->inputN) {
+    if (d->state && d->state->bits.prompt)
+      result = BufferAppend(d->output, "\r\n", 2);
+  }
+  return (result);
+}
+
+/* Descriptor helper function. */
+static void DescriptorTrackOutput(
+	Descriptor *d,
+	const char *messg, const size_t messglen) {
+  register const char *p = messg;
+  register const char *end = messg + messglen;
+  for (; p && p < end; ++p) {
+    if (*p == '\r' || *p == '\n') {
+      d->lineLength = 0;
+      if (*p == '\n')
+	d->bits.prompt = true;
+    } else if (*p == '\x1b' && p + 1 < end && p[1] == '[') {
+      if (end - p >= 4 && strncmp(p, "\x1b[2J", 4) == 0)
+	d->lineLength = 0;
+      while (p + 1 < end && !isalpha((int) *p))
+	++p;
+    } else if (*p == '\b' || *p == '\x7f') {
+      if (d->lineLength)
+	d->lineLength -= 1;
+    } else if (*p == '\t') {
+      d->lineLength += 8;
+    } else if (isprint((int) *p)) {
+      d->lineLength++;
+    }
+  }
+}
+
 /*!
  * Prints a message to a descriptor.
  * \addtogroup descriptor
@@ -241,44 +284,36 @@ void DescriptorPrint(
       Log(L_SYSTEM, "vsnprintf() failed: errno=%d.", errno);
       DescriptorClose(d);
     /* Check for output buffer overflow */
-    } else if (sizeof(d->output) < d->outputN + messglen) {
+    } else if (!DescriptorPutInterrupt(d) ||
+		!BufferAppend(d->output, messg, strlen(messg))) {
       Log(L_NETWORK, "Output overflow on descriptor %s.", d->name);
       DescriptorClose(d);
     /* Must have been OK then */
     } else {
-      /* Interrupt */
-      if (!d->bits.prompt && !d->inputN) {
-	if (d->state && d->state->bits.prompt)
-	  BPrintf(d->output, sizeof(d->output), d->outputN, "\r\n");
-      }
+      /* Flush at the end of this poll */
+      DescriptorSchedule(d);
 
-      /* Process output */
-      register const char *p = messg;
-      for (; p && *p != '\0'; ++p) {
-	d->output[d->outputN++] = *p;
-	if (strchr("\r\n", *p) != NULL) {
-	  d->lineLength = 0;
-	  if (*p == '\n')
-	    d->bits.prompt = true;
-	} else if (*p == '\x1b' && p[1] == '[') {
-	  if (strncmp(p, "\x1b[2J", 5) == 0)
-	    d->lineLength = 0;
-	  while (p && *p != '\0' && !isalpha((int) *p))
-	    d->output[d->outputN++] = *p++;
-	  d->output[d->outputN++] = *p;
-	} else if (strchr("\b\x7f", *p) != NULL) {
-	  if (d->lineLength)
-	    d->lineLength -= 1;
-	} else if (*p == '\t') {
-	  d->lineLength += 8;
-	} else if (isprint((int) *p)) {
-	  d->lineLength++;
-	}
-      }
+      /* Track line length */
+      DescriptorTrackOutput(d, messg, strlen(messg));
     }
   }
 }
 
+/*!
+ * Schedules a descriptor to be flushed, or deleted if closed,
+ * at the end of the current poll.
+ * \addtogroup descriptor
+ * \param d the descriptor to schedule
+ */
+void DescriptorSchedule(Descriptor *d) {
+  if (!d) {
+    Log(L_ASSERT, "Invalid `d` Descriptor.");
+  } else if (!d->bits.pending) {
+    ListPushFront(d->game->pending, d);
+    d->bits.pending = true;
+  }
+}
+
 /*!
  * Sends a TELNET command.
  * \addtogroup descriptor
@@ -294,14 +329,39 @@ void DescriptorPutCommand(
     Log(L_ASSERT, "Invalid `d` Descriptor.");
   } else if (DescriptorClosed(d)) {
     Log(L_ASSERT, "Descriptor %s is already closed.", d->name);
-  } else if (sizeof(d->output) < d->outputN + 3) {
+  } else if (!BufferAppend(d->output,
+		(const uint8_t[]) {IAC, telnetCommand, telnetOption}, 3)) {
     Log(L_NETWORK, "Output overflow on descriptor %s.", d->name);
     DescriptorClose(d);
   } else {
-    d->output[d->outputN++] = IAC;
-    d->output[d->outputN++] = telnetCommand;
-    d->output[d->outputN++] = telnetOption;
-    Log(L_NETWORK, "Descriptor %s sent IAC %s %s.", d->name, TELCMD(telnetCommand), TELOPT(telnetOption));
+    DescriptorSchedule(d);
+    LogTrace(L_NETWORK, "Descriptor %s sent IAC %s %s.", d->name, TELCMD(telnetCommand), TELOPT(telnetOption));
+  }
+}
+
+/*!
+ * Sends a shared message segment.
+ * \addtogroup descriptor
+ * \param d the descriptor to which to send
+ * \param segment the rendered message segment to share
+ * \sa GameBroadcast(Game*, const GameRenderFunc, const void*)
+ */
+void DescriptorPutSegment(
+	Descriptor *d,
+	BufferSegment *segment) {
+  if (!d) {
+    Log(L_ASSERT, "Invalid `d` Descriptor.");
+  } else if (!segment) {
+    Log(L_ASSERT, "Invalid `segment` BufferSegment.");
+  } else if (DescriptorClosed(d)) {
+    Log(L_ASSERT, "Descriptor %s is already closed.", d->name);
+  } else if (!DescriptorPutInterrupt(d) ||
+	      !BufferAppendSegment(d->output, segment)) {
+    Log(L_NETWORK, "Output overflow on descriptor %s.", d->name);
+    DescriptorClose(d);
+  } else {
+    DescriptorSchedule(d);
+    DescriptorTrackOutput(d, segment->data, segment->length);
   }
 }
 
@@ -330,18 +390,18 @@ static void DescriptorReceiveTelnetSubNegotiation(Descriptor *d) {
     switch (d->telnetOption) {
     case TELOPT_NAWS:
       if (d->sbN != 4) {
-	Log(L_NETWORK, "Descriptor %s received malformed NAWS subnegotiation.", d->name);
+	LogDebug(L_NETWORK, "Descriptor %s received malformed NAWS subnegotiation.", d->name);
       } else {
 	d->windowWidth  = ntohs(*((uint16_t*)(d->sb + 0)));
 	d->windowHeight = ntohs(*((uint16_t*)(d->sb + 2)));
-	Log(L_NETWORK, "Descriptor %s has window size %hu x %hu", d->name, d->windowWidth, d->windowHeight);
+	LogDebug(L_NETWORK, "Descriptor %s has window size %hu x %hu", d->name, d->windowWidth, d->windowHeight);
       }
       break;
     case TELOPT_TTYPE:
-      Log(L_NETWORK, "Descriptor %s has terminal-type %s.", d->name, d->sbN ? d->sb : "<None>");
+      LogDebug(L_NETWORK, "Descriptor %s has terminal-type %s.", d->name, d->sbN ? d->sb : "<None>");
       break;
     default:
-      Log(L_NETWORK, "Descriptor %s received unsupported %s subnegotiation.", d->name, TELOPT(d->telnetOption));
+      LogDebug(L_NETWORK, "Descriptor %s received unsupported %s subnegotiation.", d->name, TELOPT(d->telnetOption));
       break;
     }
   }
@@ -358,10 +418,10 @@ static void DescriptorReceiveTelnet(Descriptor *d) {
     if (d->telnetCommand != DO && d->telnetCommand != DONT &&
 	d->telnetCommand != WILL && d->telnetCommand != WONT &&
 	d->telnetCommand != SB) {
-      Log(L_NETWORK, "Descriptor %s received IAC %s.", d->name,
+      LogTrace(L_NETWORK, "Descriptor %s received IAC %s.", d->name,
 	TELCMD(d->telnetCommand));
     } else {
-      Log(L_NETWORK, "Descriptor %s received IAC %s %s.", d->name,
+      LogTrace(L_NETWORK, "Descriptor %s received IAC %s %s.", d->name,
 	TELCMD(d->telnetCommand),
 	TELOPT(d->telnetOption));
     }
@@ -411,6 +471,7 @@ static void DescriptorReceiveInput(Descriptor *d) {
       d->state->received(d, d->game, d->input);
 
     d->bits.prompt = true;
+    DescriptorSchedule(d);
   }
 }
 
@@ -481,7 +542,7 @@ static void DescriptorReceiveByte(
       DescriptorReceiveTelnet(d);
       break;
     default:
-      Log(L_NETWORK, "Descriptor %s has unknown state IAC %s.", d->name, TELCMD(d->telnetCommand));
+      LogDebug(L_NETWORK, "Descriptor %s has unknown state IAC %s.", d->name, TELCMD(d->telnetCommand));
       d->telnetCommand = /* None */ 0;
       break;
     }
@@ -499,25 +560,28 @@ void DescriptorReceive(Descriptor *d) {
   } else if (DescriptorClosed(d)) {
     Log(L_ASSERT, "Descriptor %s is already closed.", d->name);
   } else {
-    /* Try to read socket */
+    /*
+     * Read until the socket would block or the stream ends; a short
+     * read may still leave end of stream unread, and edge-triggered
+     * polling won't report it again.
+     */
     uint8_t messg[MAXLEN_INPUT] = {'\0'};
-    const ssize_t nBytes = SocketRead(d->socket, messg, sizeof(messg));
-
-    /* Socket read error */
-    if (nBytes < 0) {
-      Log(L_NETWORK, "Couldn't read descriptor %s.", d->name);
-      DescriptorClose(d);
-    /* Remote host closed descriptor */
-    } else if (!nBytes) {
-      Log(L_NETWORK, "EOF read on descriptor %s.", d->name);
-      DescriptorClose(d);
-    } else {
-      /* Telnet protocol */
-      register size_t messgN = 0;
-      for (; !DescriptorClosed(d) && messgN < (size_t) nBytes; ++messgN) {
-	DescriptorReceiveByte(d, messg[messgN]);
+    register ssize_t nBytes = 0;
+    do {
+      nBytes = SocketRead(d->socket, messg, sizeof(messg));
+
+      /* Socket read error or remote host closed descriptor */
+      if (nBytes < 0) {
+	Log(L_NETWORK, "Lost descriptor %s while reading.", d->name);
+	DescriptorClose(d);
+      } else {
+	/* Telnet protocol */
+	register size_t messgN = 0;
+	for (; !DescriptorClosed(d) && messgN < (size_t) nBytes; ++messgN) {
+	  DescriptorReceiveByte(d, messg[messgN]);
+	}
       }
-    }
+    } while (!DescriptorClosed(d) && nBytes > 0);
   }
 }
 
@@ -588,6 +652,17 @@ STATE(LoginUserIdOnReceived) {
   return (true);
 }
 
+/*! Descriptor helper function. */
+static void PlayingRenderMessage(
+	const Descriptor *d,
+	char *messg, const size_t messglen,
+	const void *userData) {
+  const Descriptor *from = userData;
+  snprintf(messg, messglen, "%sFrom %s%s%s: %s%s%s\r\n",
+	QX_PROMPT, QX_EMPHASIS, from->user->userId, QX_PUNCTUATION,
+	QX_PROMPT, from->input, Q_NORMAL);
+}
+
 /*! Descriptor state function. */
 STATE(PlayingOnReceived) {
   if (!d->user) {
@@ -598,12 +673,7 @@ STATE(PlayingOnReceived) {
     UserSave(game, d->user);
     DescriptorClose(d);
   } else {
-    TreeForEach(game->descriptors, tDescNode) {
-      Descriptor *tDesc = tDescNode->mappingValue;
-      DescriptorPrint(tDesc, "%sFrom %s%s%s: %s%s%s\r\n",
-		QX_PROMPT, QX_EMPHASIS, d->user->userId, QX_PUNCTUATION,
-		QX_PROMPT, input, Q_NORMAL);
-    }
+    GameBroadcast(game, PlayingRenderMessage, d);
   }
   return (true);
 }
@@ -10,11 +10,15 @@
  */
 #define _SCRATCH_GAME_C_
 
+#include <scratch/buffer.h>
+#include <scratch/config.h>
 #include <scratch/descriptor.h>
 #include <scratch/game.h>
 #include <scratch/list.h>
 #include <scratch/log.h>
 #include <scratch/memory.h>
+#include <scratch/poller.h>
+#include <scratch/resolver.h>
 #include <scratch/scratch.h>
 #include <scratch/socket.h>
 #include <scratch/state.h>
@@ -46,25 +50,35 @@ void GameAccept(Game *game) {
       SOCKADDR *peer = &d->socket->address;
       socklen_t peerSZ = sizeof(SOCKADDR);
 
-      /* Get socket name */
+      /* Get numeric socket name; the hostname is resolved later */
       char name[INET6_ADDRSTRLEN] = {'\0'};
-      if (getnameinfo(peer, peerSZ, name, sizeof(name), 0, 0, 0) < 0) {
+      if (getnameinfo(peer, peerSZ, name, sizeof(name), 0, 0, NI_NUMERICHOST) != 0) {
 	Log(L_SYSTEM, "getnameinfo() failed: errno=%d.", errno);
 	strlcpy(name, "*Unknown*", sizeof(name));
       }
 
-      /* Set hostname */
+      /* Set hostname from the cache, if possible */
+      const char *hostname = game->resolver ? ResolverGet(game->resolver, name) : NULL;
       MemoryFree(d->hostname);
-      d->hostname = strdup(name);
+      d->hostname = strdup(hostname ? hostname : name);
 
       /* Add descriptor to descriptor index */
       if (!TreeInsert(game->descriptors, &d->name, d)) {
 	Log(L_NETWORK, "Couldn't add descriptor %s to descriptor index.", d->name);
 	DescriptorFree(d), d = NULL;
+      /* Watch descriptor for network events */
+      } else if (!PollerAdd(game->poller, d->socket, POLLER_READ | POLLER_EDGE, d)) {
+	Log(L_NETWORK, "Couldn't watch descriptor %s.", d->name);
+	TreeDelete(game->descriptors, &d->name), d = NULL;
       }
 
       if (d) {
 	Log(L_NETWORK, "Accepted descriptor %s from %s.", d->name, d->hostname);
+
+	/* Resolve hostname off the game loop */
+	if (!hostname && game->resolver)
+	  ResolverQueue(game->resolver, d->name, peer, peerSZ, name);
+
 	DescriptorPutCommand(d, DO, TELOPT_ECHO);   /* Remote echo */
 	DescriptorPutCommand(d, WONT, TELOPT_ECHO); /* Local won't echo */
 	DescriptorPutCommand(d, DO, TELOPT_NAWS);   /* Remote NAWS */
@@ -78,6 +92,50 @@ void GameAccept(Game *game) {
   }
 }
 
+/*!
+ * Broadcasts a message to every open descriptor.  The message is
+ * rendered once per color mode, for the first recipient in that
+ * mode, and the rendered segment is shared by all recipients.
+ * \addtogroup game
+ * \param game the game state
+ * \param render the function to render the message
+ * \param userData the user-specified data to pass to \p render
+ */
+void GameBroadcast(
+	Game *game,
+	const GameRenderFunc render,
+	const void *userData) {
+  if (!game) {
+    Log(L_ASSERT, "Invalid `game` Game.");
+  } else if (!render) {
+    Log(L_ASSERT, "Invalid `render` GameRenderFunc.");
+  } else {
+    /* Rendered segments: plain and color */
+    BufferSegment *segments[2] = {NULL, NULL};
+
+    TreeForEach(game->descriptors, tDescNode) {
+      Descriptor *tDesc = tDescNode->mappingValue;
+      if (!DescriptorClosed(tDesc)) {
+	const size_t mode = tDesc->bits.color ? 1 : 0;
+
+	/* Render message */
+	if (!segments[mode]) {
+	  char messg[MAXLEN_STRING] = {'\0'};
+	  render(tDesc, messg, sizeof(messg), userData);
+	  segments[mode] = BufferSegmentAlloc(messg, strlen(messg));
+	}
+
+	/* Share rendered message */
+	DescriptorPutSegment(tDesc, segments[mode]);
+      }
+    }
+
+    /* Release rendered segments */
+    BufferSegmentFree(segments[0]);
+    BufferSegmentFree(segments[1]);
+  }
+}
+
 /*!
  * Constructs a new game state.
  * \addtogroup game
@@ -87,7 +145,11 @@ void GameAccept(Game *game) {
 Game *GameAlloc(void) {
   Game *game;
   MemoryCreate(game, Game, 1);
+  game->config = ConfigAlloc();
   game->descriptors = TreeAlloc(UtilityNameCompareV, NULL, DescriptorFreeV);
+  game->pending = ListAlloc(NULL, NULL);
+  game->poller = NULL;
+  game->resolver = NULL;
   game->shutdown = false;
   game->socket = NULL;
   game->states = TreeAlloc(UtilityNameCompareV, NULL, StateFreeV);
@@ -104,8 +166,12 @@ Game *GameAlloc(void) {
 void GameFree(Game *game) {
   if (game) {
     TreeFree(game->descriptors);
+    ListFree(game->pending);
     TreeFree(game->states);
     SocketClose(game->socket);
+    ResolverFree(game->resolver);
+    PollerFree(game->poller);
+    ConfigFree(game->config);
     MemoryFree(game);
   }
 }
@@ -126,10 +192,20 @@ void GameOpen(
   } else if (!SocketClosed(game->socket)) {
     Log(L_ASSERT, "Server control socket already open.");
   } else {
+    /* Network event poller */
+    if (!game->poller)
+      game->poller = PollerAlloc(game->config->poller);
+
     game->socket = SocketAlloc();
-    if (!SocketOpen(game->socket, address, port)) {
+    if (!game->poller) {
+      Log(L_NETWORK, "Couldn't open server without a poller.");
+      SocketClose(game->socket), game->socket = NULL;
+    } else if (!SocketOpen(game->socket, address, port)) {
       Log(L_NETWORK, "Couldn't open server using address '%s', port %hu.", address && *address != '\0' ? address : "<Blank>", port);
       SocketClose(game->socket), game->socket = NULL;
+    } else if (!PollerAdd(game->poller, game->socket, POLLER_READ, NULL)) {
+      Log(L_NETWORK, "Couldn't watch server control socket.");
+      SocketClose(game->socket), game->socket = NULL;
     } else if (address && *address != '\0') {
       Log(L_NETWORK, "Opened server on %s, port %hu.", address, port);
     } else {
@@ -161,6 +237,23 @@ bool GameParseArguments(
   return (result);
 }
 
+/* Game helper function. */
+static void GameResolved(
+	const char *key,
+	const char *numeric,
+	const char *hostname,
+	void *userData) {
+  Game *game = userData;
+  Descriptor *d = TreeGetValue(game->descriptors, &key, NULL);
+
+  /* Patch hostname unless the descriptor is gone */
+  if (d && !DescriptorClosed(d) && d->hostname && !strcmp(d->hostname, numeric) && strcmp(hostname, numeric) != 0) {
+    Log(L_NETWORK, "Resolved descriptor %s from %s to %s.", d->name, numeric, hostname);
+    MemoryFree(d->hostname);
+    d->hostname = strdup(hostname);
+  }
+}
+
 /*!
  * Polls for network events.
  * \addtogroup game
@@ -174,81 +267,47 @@ void GamePoll(
 	Time *timeout) {
   if (!game) {
     Log(L_ASSERT, "Invalid `game` Game.");
-  } else {
-    /* Reader sockets */
-    fd_set readers;
-    FD_ZERO(&readers);
-
-    /* Writer sockets */
-    fd_set writers;
-    FD_ZERO(&writers);
-
-    /* Highest valued handle */
-    SOCKET topHandle = INVALID_SOCKET;
-
-    /* Control socket */
-    if (!SocketClosed(game->socket)) {
-      FD_SET(game->socket->handle, &readers);
-      topHandle = game->socket->handle;
-    }
+  } else if (PollerWait(game->poller, timeout) >= 0) {
+    /* Dispatch ready sockets only */
+    PollerForEach(game->poller, tEvent) {
+      /* Control socket network events */
+      if (!SocketClosed(game->socket) && tEvent->handle == game->socket->handle) {
+	GameAccept(game);
+	continue;
+      }
 
-    /* Configure read and write sets */
-    TreeForEach(game->descriptors, tDescNode) {
-      /* Iterator variable */
-      Descriptor *tDesc = tDescNode->mappingValue;
+      /* Resolved hostnames */
+      if (game->resolver && !SocketClosed(game->resolver->wakeup) && tEvent->handle == game->resolver->wakeup->handle) {
+	ResolverPoll(game->resolver, GameResolved, game);
+	continue;
+      }
 
-      /* Skip closed descriptors */
+      /* Skip descriptors closed earlier in this pass */
+      Descriptor *tDesc = tEvent->userData;
       if (DescriptorClosed(tDesc))
 	continue;
 
-      /* Writer membership */
-      if (tDesc->bits.prompt || tDesc->outputN)
-	FD_SET(tDesc->socket->handle, &writers);
-
-      /* Reader membership */
-      FD_SET(tDesc->socket->handle, &readers);
+      /* Check readers */
+      if (tEvent->events & (POLLER_READ | POLLER_ERROR))
+	DescriptorReceive(tDesc);
 
-      /* Maximum socket handle value */
-      if (tDesc->socket->handle > topHandle)
-	topHandle = tDesc->socket->handle;
+      /* Check writers */
+      if (tEvent->events & POLLER_WRITE)
+	DescriptorSchedule(tDesc);
     }
 
-    /* Wait for network events */
-    const int howMany = select(
-	topHandle + 1, &readers, &writers, NULL, timeout);
-
-    if (howMany < 0 && errno != EINTR) {
-      Log(L_SYSTEM, "select() failed: errno=%d.", errno);
-    } else {
-      /* Check read and write sets */
-      List *closed = ListAlloc(NULL, NULL);
-      TreeForEach(game->descriptors, tDescNode) {
-	/* Iterator variable */
-	Descriptor *tDesc = tDescNode->mappingValue;
-
-	/* Check readers */
-	if (SocketCheck(tDesc->socket, &readers))
-	  DescriptorReceive(tDesc);
-
-	/* Check writers */
-	if (SocketCheck(tDesc->socket, &writers))
-	  DescriptorFlush(tDesc);
-
-	/* Check closed descriptors */
-	if (DescriptorClosed(tDesc))
-	  ListPushBack(closed, tDesc);
-      }
+    /* Flush output and delete closed descriptors */
+    Descriptor *tDesc;
+    while ((tDesc = ListFrontValue(game->pending, NULL)) != NULL) {
+      ListRemoveNoFree(game->pending, tDesc);
 
-      /* Control socket network events */
-      if (SocketCheck(game->socket, &readers))
-	GameAccept(game);
+      /* Flush while still marked pending */
+      if (!DescriptorClosed(tDesc))
+	DescriptorFlush(tDesc);
 
-      /* Delete closed descriptors */
-      ListForEach(closed, tDescNode) {
-	Descriptor *tDesc = tDescNode->value;
+      tDesc->bits.pending = false;
+      if (DescriptorClosed(tDesc))
 	TreeDelete(game->descriptors, &tDesc->name);
-      }
-      ListFree(closed);
     }
   }
 }
@@ -262,6 +321,16 @@ void GameRun(Game *game) {
   if (!game) {
     Log(L_ASSERT, "Invalid `game` Game.");
   } else {
+    /* Load game configuration */
+    ConfigLoad(game);
+
+    /* Hostname resolver */
+    game->resolver = ResolverAlloc(
+	game->config->resolverWorkers,
+	game->config->resolverCacheMax,
+	game->config->resolverCacheTtl,
+	NULL);
+
     /* Load connection states */
     StateLoadIndex(game);
 
@@ -273,6 +342,11 @@ void GameRun(Game *game) {
     if (SocketClosed(game->socket))
       return;
 
+    /* Watch for resolved hostnames */
+    if (!SocketClosed(game->resolver->wakeup) &&
+	 !PollerAdd(game->poller, game->resolver->wakeup, POLLER_READ, NULL))
+      Log(L_NETWORK, "Couldn't watch hostname resolver.");
+
     /* Run game loop */
     Log(L_NETWORK, "Starting game loop.");
     while (!game->shutdown) {
@@ -286,6 +360,9 @@ void GameRun(Game *game) {
     Log(L_NETWORK, "Game loop finished.");
 
     /* Close server */
+    if (!SocketClosed(game->resolver->wakeup))
+      PollerRemove(game->poller, game->resolver->wakeup);
+    PollerRemove(game->poller, game->socket);
     SocketClose(game->socket);
   }
 }
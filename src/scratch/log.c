@@ -11,58 +11,514 @@
 #define _SCRATCH_LOG_C_
 
 #include <scratch/log.h>
+#include <scratch/memory.h>
 #include <scratch/scratch.h>
+#include <scratch/string.h>
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_STDATOMIC_H)
+#define LOG_ASYNC
+#endif /* HAVE_PTHREAD_H && HAVE_STDATOMIC_H */
+
+/*! The length of a log line. */
+#define MAXLEN_LOG		(1024)
+
+/*! The length of a log writer batch. */
+#define MAXLEN_LOGBATCH		(1024 * 64)
+
+/*! The number of log queue slots; must be a power of two. */
+#define LOG_SLOTS		(2048)
+
+/*! The interval, in milliseconds, after which a full log queue is retried. */
+#define LOG_RETRY		(10)
+
+/*! The lowest log level emitted for each log type. */
+int g_logLevels[L_MAX] = {
+  [L_ASSERT]  = LOG_INFO,
+  [L_DATA]    = LOG_INFO,
+  [L_MAIN]    = LOG_INFO,
+  [L_NETWORK] = LOG_INFO,
+  [L_STATE]   = LOG_INFO,
+  [L_SYSTEM]  = LOG_INFO,
+  [L_USER]    = LOG_INFO,
+};
+
+/*! The log level names. */
+static const char *LogLevelNames[] = {
+  [LOG_TRACE] = "trace",
+  [LOG_DEBUG] = "debug",
+  [LOG_INFO]  = "info",
+  [LOG_WARN]  = "warn",
+  [LOG_ERROR] = "error",
+};
+
+/*! The log type names. */
+static const char *LogTypeNames[L_MAX] = {
+  [L_ASSERT]  = "Assert",
+  [L_DATA]    = "Data",
+  [L_MAIN]    = "Main",
+  [L_NETWORK] = "Network",
+  [L_STATE]   = "State",
+  [L_SYSTEM]  = "System",
+  [L_USER]    = "User",
+};
+
+/*! The log file, kept open for the current day. */
+static int LogFile = -1;
+
+/*! The day of the open log file. */
+static int LogFileDay = -1;
+
+#ifdef HAVE_PTHREAD_H
+/*! The lock for the log file, which any thread may write. */
+static pthread_mutex_t LogFileLock = PTHREAD_MUTEX_INITIALIZER;
+#endif /* HAVE_PTHREAD_H */
+
+/* Log helper function. */
+static size_t LogFormatV(
+	char *out, const size_t outlen,
+	const char *fileName,
+	const int fileLine,
+	const int level,
+	const int type,
+	const char *format,
+	va_list args) {
+  /* Leave room for the EOL character */
+  const size_t limit = outlen - 1;
+  register size_t outN = 0;
+
+  /* Current time */
+  const time_t now = time(0);
+  struct tm nowtm;
+  localtime_r(&now, &nowtm);
+
+#define LogClamp(r) \
+  do { \
+    const int r_ = (r); \
+    if (r_ > 0) \
+      outN += r_; \
+    if (outN >= limit) \
+      outN = limit - 1; \
+  } while (0)
+
+  /* Timestamp */
+  outN = strftime(out, limit, "%F %H:%M:%S ", &nowtm);
+
+  /* Log type and level */
+  LogClamp(snprintf(out + outN, limit - outN, "[%s] %s: ",
+	LogTypeName(type), level >= LOG_TRACE && level <= LOG_ERROR ? LogLevelNames[level] : "?"));
+
+  /* Message */
+  LogClamp(vsnprintf(out + outN, limit - outN, format, args));
+
+  /* Filename and line number */
+  LogClamp(snprintf(out + outN, limit - outN, " {%s:%d}", fileName, fileLine));
+
+#undef LogClamp
+
+  /* EOL character */
+  out[outN++] = '\n';
+  return (outN);
+}
+
+/* Log helper function. */
+static size_t LogFormat(
+	char *out, const size_t outlen,
+	const char *fileName,
+	const int fileLine,
+	const int level,
+	const int type,
+	const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  const size_t outN = LogFormatV(out, outlen, fileName, fileLine, level, type, format, args);
+  va_end(args);
+  return (outN);
+}
+
+/* Log helper function. */
+static void LogWriteFile(
+	const char *messg,
+	const size_t messglen) {
+  /* Current time */
+  const time_t now = time(0);
+  struct tm nowtm;
+  localtime_r(&now, &nowtm);
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&LogFileLock);
+#endif /* HAVE_PTHREAD_H */
+
+  /* Rotate log file at midnight */
+  const int day = nowtm.tm_year * 1000 + nowtm.tm_yday;
+  if (LogFile < 0 || LogFileDay != day) {
+    char logname[PATH_MAX] = {'\0'};
+    strftime(logname, sizeof(logname), "log/%m%d.log", &nowtm);
+
+    if (LogFile >= 0)
+      close(LogFile), LogFile = -1;
+
+    if ((LogFile = open(logname, O_WRONLY | O_APPEND | O_CREAT, 0644)) >= 0)
+      LogFileDay = day;
+  }
+
+  /* Write log lines */
+  const int fd = LogFile >= 0 ? LogFile : STDERR_FILENO;
+  register size_t nBytes = 0;
+  while (nBytes < messglen) {
+    const ssize_t result = write(fd, messg + nBytes, messglen - nBytes);
+    if (result < 0 && errno == EINTR)
+      continue;
+    else if (result <= 0)
+      break;
+    nBytes += result;
+  }
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock(&LogFileLock);
+#endif /* HAVE_PTHREAD_H */
+}
+
+#ifdef LOG_ASYNC
+/*!
+ * The log queue slot structure.
+ * \addtogroup log
+ * \{
+ */
+typedef struct LogSlot {
+  char                  line[MAXLEN_LOG]; /*!< The formatted log line */
+  size_t                length;         /*!< The formatted log line length */
+  atomic_size_t         sequence;       /*!< The slot sequence number */
+} LogSlot;
+/*! \} */
+
+/*!
+ * The log queue structure.  Producers claim slots with an atomic
+ * head counter and publish them by sequence number; the log writer
+ * is the only consumer.
+ * \addtogroup log
+ * \{
+ */
+typedef struct LogQueue {
+  pthread_cond_t        drained;        /*!< Signalled as lines are written */
+  atomic_size_t         dropped;        /*!< The lines dropped since last report */
+  atomic_size_t         head;           /*!< The next slot to claim */
+  pthread_mutex_t       lock;           /*!< The lock for sleeping and waking */
+  atomic_int            policy;         /*!< The backpressure policy: LOG_x */
+  atomic_bool           running;        /*!< The log writer is running */
+  atomic_bool           sleeping;       /*!< The log writer is idle */
+  LogSlot              *slots;          /*!< The queue slots */
+  pthread_t             thread;         /*!< The log writer thread */
+  pthread_cond_t        wakeup;         /*!< Signalled as lines are queued */
+  atomic_size_t         written;        /*!< The slots written so far */
+} LogQueue;
+/*! \} */
+
+/*! The log queue. */
+static LogQueue LogQueueState = {
+  .drained = PTHREAD_COND_INITIALIZER,
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .policy = LOG_BLOCK,
+  .slots = NULL,
+  .wakeup = PTHREAD_COND_INITIALIZER,
+};
+
+/* Log helper function. */
+static void LogWait(
+	pthread_cond_t *cond,
+	const long milliseconds) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += milliseconds / 1000;
+  deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec += 1;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  pthread_cond_timedwait(cond, &LogQueueState.lock, &deadline);
+}
+
+/* Log helper function. */
+static void LogWake(void) {
+  pthread_mutex_lock(&LogQueueState.lock);
+  pthread_cond_signal(&LogQueueState.wakeup);
+  pthread_mutex_unlock(&LogQueueState.lock);
+}
+
+/* Log helper function. */
+static bool LogReady(const size_t tail) {
+  LogSlot *slot = &LogQueueState.slots[tail & (LOG_SLOTS - 1)];
+  return atomic_load(&slot->sequence) == tail + 1;
+}
+
+/* Log helper function. */
+static void LogEnqueue(
+	const char *line,
+	const size_t linelen) {
+  size_t pos = atomic_load_explicit(&LogQueueState.head, memory_order_relaxed);
+  register LogSlot *slot = NULL;
+  for (;;) {
+    slot = &LogQueueState.slots[pos & (LOG_SLOTS - 1)];
+    const size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    const intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+
+    if (diff == 0) {
+      /* Claim slot */
+      if (atomic_compare_exchange_weak(&LogQueueState.head, &pos, pos + 1))
+	break;
+    } else if (diff < 0) {
+      /* Queue is full */
+      if (atomic_load(&LogQueueState.policy) == LOG_DROP) {
+	atomic_fetch_add(&LogQueueState.dropped, 1);
+	return;
+      }
+
+      /*
+       * Wait for the log writer to make room; the timeout covers a
+       * drain that finishes before this thread starts waiting
+       */
+      pthread_mutex_lock(&LogQueueState.lock);
+      pthread_cond_signal(&LogQueueState.wakeup);
+      LogWait(&LogQueueState.drained, LOG_RETRY);
+      pthread_mutex_unlock(&LogQueueState.lock);
+      pos = atomic_load(&LogQueueState.head);
+    } else {
+      /* Another producer claimed slot */
+      pos = atomic_load_explicit(&LogQueueState.head, memory_order_relaxed);
+    }
+  }
+
+  /* Publish slot */
+  MemoryCopy(slot->line, line, char, linelen);
+  slot->length = linelen;
+  atomic_store(&slot->sequence, pos + 1);
+
+  /* Wake log writer */
+  if (atomic_load(&LogQueueState.sleeping))
+    LogWake();
+}
+
+/* Log helper function. */
+static void *LogWriter(void *unused) {
+  static char batch[MAXLEN_LOGBATCH];
+  register size_t tail = 0;
+  (void) unused;
+  for (;;) {
+    register size_t batchN = 0;
+
+    /* Report dropped lines */
+    const size_t dropped = atomic_exchange(&LogQueueState.dropped, 0);
+    if (dropped) {
+      batchN += LogFormat(batch, MAXLEN_LOG, __FILE__, __LINE__, LOG_WARN, L_SYSTEM,
+	"Dropped %zu log message(s).", dropped);
+    }
+
+    /* Gather published lines */
+    while (batchN + MAXLEN_LOG <= sizeof(batch) && LogReady(tail)) {
+      LogSlot *slot = &LogQueueState.slots[tail & (LOG_SLOTS - 1)];
+      MemoryCopy(batch + batchN, slot->line, char, slot->length);
+      batchN += slot->length;
+      atomic_store_explicit(&slot->sequence, tail + LOG_SLOTS, memory_order_release);
+      tail++;
+    }
+
+    if (batchN) {
+      /* Write batch */
+      LogWriteFile(batch, batchN);
+
+      pthread_mutex_lock(&LogQueueState.lock);
+      atomic_store(&LogQueueState.written, tail);
+      pthread_cond_broadcast(&LogQueueState.drained);
+      pthread_mutex_unlock(&LogQueueState.lock);
+    } else if (!atomic_load(&LogQueueState.running)) {
+      break;
+    } else {
+      /* Idle until lines are queued */
+      pthread_mutex_lock(&LogQueueState.lock);
+      atomic_store(&LogQueueState.sleeping, true);
+      if (!LogReady(tail) && atomic_load(&LogQueueState.running))
+	pthread_cond_wait(&LogQueueState.wakeup, &LogQueueState.lock);
+      atomic_store(&LogQueueState.sleeping, false);
+      pthread_mutex_unlock(&LogQueueState.lock);
+    }
+  }
+  return (NULL);
+}
+#endif /* LOG_ASYNC */
+
+/*!
+ * Stops the log writer after writing every queued log message.
+ * \addtogroup log
+ * \sa LogStartup()
+ */
+void LogCleanup(void) {
+#ifdef LOG_ASYNC
+  if (atomic_load(&LogQueueState.running)) {
+    /* Stop log writer */
+    pthread_mutex_lock(&LogQueueState.lock);
+    atomic_store(&LogQueueState.running, false);
+    pthread_cond_signal(&LogQueueState.wakeup);
+    pthread_mutex_unlock(&LogQueueState.lock);
+    pthread_join(LogQueueState.thread, NULL);
+    MemoryFree(LogQueueState.slots);
+  }
+#endif /* LOG_ASYNC */
+
+  /* Close log file */
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&LogFileLock);
+#endif /* HAVE_PTHREAD_H */
+  if (LogFile >= 0) {
+    close(LogFile);
+    LogFile = -1;
+    LogFileDay = -1;
+  }
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock(&LogFileLock);
+#endif /* HAVE_PTHREAD_H */
+}
+
+/*!
+ * Blocks until every queued log message has been written.
+ * \addtogroup log
+ */
+void LogFlush(void) {
+#ifdef LOG_ASYNC
+  if (atomic_load(&LogQueueState.running)) {
+    const size_t target = atomic_load(&LogQueueState.head);
+    pthread_mutex_lock(&LogQueueState.lock);
+    pthread_cond_signal(&LogQueueState.wakeup);
+    while (atomic_load(&LogQueueState.written) < target &&
+	   atomic_load(&LogQueueState.running))
+      pthread_cond_wait(&LogQueueState.drained, &LogQueueState.lock);
+    pthread_mutex_unlock(&LogQueueState.lock);
+  }
+#endif /* LOG_ASYNC */
+}
+
+/*!
+ * Looks up a log level by name.
+ * \addtogroup log
+ * \param name the log level name: trace, debug, info, warn, or error
+ * \return the LOG_x log level, or -1 if the name is unknown
+ */
+int LogLevelByName(const char *name) {
+  register int level;
+  for (level = LOG_TRACE; name && level <= LOG_ERROR; ++level) {
+    if (!StringCaseCompare(name, LogLevelNames[level]))
+      return (level);
+  }
+  return (-1);
+}
+
+/*!
+ * Sets the lowest log level emitted for a log type.
+ * \addtogroup log
+ * \param type the log message type: L_x
+ * \param level the log level: LOG_x
+ */
+void LogSetLevel(
+	const int type,
+	const int level) {
+  if (type < 0 || type >= L_MAX) {
+    Log(L_ASSERT, "Invalid `type` log type %d.", type);
+  } else if (level < LOG_TRACE || level > LOG_ERROR) {
+    Log(L_ASSERT, "Invalid `level` log level %d.", level);
+  } else {
+    g_logLevels[type] = level;
+  }
+}
+
+/*!
+ * Sets the log backpressure policy.
+ * \addtogroup log
+ * \param policy the policy to apply when the log queue is full: LOG_x
+ */
+void LogSetPolicy(const int policy) {
+#ifdef LOG_ASYNC
+  atomic_store(&LogQueueState.policy, policy);
+#endif /* LOG_ASYNC */
+}
+
+/*!
+ * Returns the name of a log type.
+ * \addtogroup log
+ * \param type the log message type: L_x
+ * \return the name of the specified log type, e.g. "Network"
+ */
+const char *LogTypeName(const int type) {
+  return (type >= 0 && type < L_MAX ? LogTypeNames[type] : "Unknown");
+}
+
+/*!
+ * Starts the log writer.  Until it starts, and after it stops,
+ * log messages are written synchronously.
+ * \addtogroup log
+ * \sa LogCleanup()
+ */
+void LogStartup(void) {
+#ifdef LOG_ASYNC
+  if (!atomic_load(&LogQueueState.running)) {
+    /* Initialize queue */
+    MemoryCreate(LogQueueState.slots, LogSlot, LOG_SLOTS);
+    register size_t i;
+    for (i = 0; i < LOG_SLOTS; ++i)
+      atomic_init(&LogQueueState.slots[i].sequence, i);
+    atomic_store(&LogQueueState.dropped, 0);
+    atomic_store(&LogQueueState.head, 0);
+    atomic_store(&LogQueueState.sleeping, false);
+    atomic_store(&LogQueueState.written, 0);
+
+    /* Start log writer */
+    atomic_store(&LogQueueState.running, true);
+    const int result = pthread_create(&LogQueueState.thread, NULL, LogWriter, NULL);
+    if (result != 0) {
+      atomic_store(&LogQueueState.running, false);
+      MemoryFree(LogQueueState.slots);
+      Log(L_SYSTEM, "pthread_create() failed: errno=%d.", result);
+    }
+  }
+#endif /* LOG_ASYNC */
+}
 
 /*!
  * Emits a log message.
  * \addtogroup log
  * \param fileName the filename to write to the log file
  * \param fileLine the line number to write to the log file
- * \param type the log message type
+ * \param level the log level: LOG_x
+ * \param type the log message type: L_x
  * \param format the prinft-style format specifier
  */
 void RealLog(
 	const char *fileName,
 	const int fileLine,
-	const char *type,
+	const int level,
+	const int type,
 	const char *format, ...) {
   if (format && *format != '\0') {
-    /* Current time */
-    const time_t now = time(0);
-    struct tm *nowtm = localtime(&now);
-
-    /* Construct log filename */
-    char logname[PATH_MAX] = {'\0'};
-    strftime(logname, sizeof(logname), "log/%m%d.log", nowtm);
-
-    /* Open log file */
-    FILE *stream = fopen(logname, "a+t");
-    if (!stream)
-      stream = stderr;
-
-    /* Write timestamp to log file */
-    strftime(logname, sizeof(logname), "%F %H:%M:%S", nowtm);
-    fprintf(stream, "%s ", logname);
-
-    /* Log type */
-    if (type && *type != '\0')
-      fprintf(stream, "[%s] ", type);
-
-    /* Print the message out to the log file */
+    /* Format log line */
+    char line[MAXLEN_LOG] = {'\0'};
     va_list args;
     va_start(args, format);
-    vfprintf(stream, format, args);
+    const size_t linelen = LogFormatV(line, sizeof(line), fileName, fileLine, level, type, format, args);
     va_end(args);
 
-    /* Write filename and line number */
-    fprintf(stream, " {%s:%d}", fileName, fileLine);
+#ifdef LOG_ASYNC
+    if (atomic_load(&LogQueueState.running)) {
+      /* Queue log line for the log writer */
+      LogEnqueue(line, linelen);
 
-    /* Write an EOL character to the log file */
-    fprintf(stream, "\n");
-    fflush(stream);
+      /*
+       * Errors are written before returning, since an abort()
+       * often follows
+       */
+      if (level >= LOG_ERROR)
+	LogFlush();
+      return;
+    }
+#endif /* LOG_ASYNC */
 
-    /* Close the log file */
-    if (stream != stderr)
-      fclose(stream);
+    /* Write log line */
+    LogWriteFile(line, linelen);
   }
 }
@@ -25,6 +25,9 @@ int main(int argc, const char *argv[]);
  * \return zero for normal program termination, non-zero otherwise
  */
 int main(int argc, const char *argv[]) {
+  /* Log writer */
+  LogStartup();
+
   /* Configure RNG state */
   Log(L_MAIN, "Seeding shared RNG state.");
   RandomReseedTime(&g_random, NULL);
@@ -47,5 +50,6 @@ int main(int argc, const char *argv[]) {
 
   /* Exit */
   Log(L_MAIN, "Exiting.");
+  LogCleanup();
   return (EXIT_SUCCESS);
 }
@@ -0,0 +1,479 @@
+/*!
+ * \file poller.c
+ *
+ * \par Copyright
+ * Copyright (C) 1999-2023 scratchmud.org
+ * All rights reserved.
+ *
+ * \author Geoffrey Davis <gdavis@scratchmud.org>
+ * \addtogroup poller
+ */
+#define _SCRATCH_POLLER_C_
+
+#include <scratch/log.h>
+#include <scratch/memory.h>
+#include <scratch/poller.h>
+#include <scratch/scratch.h>
+#include <scratch/socket.h>
+#include <scratch/string.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif /* HAVE_SYS_EPOLL_H */
+
+/*! The most events returned by one wait. */
+#define POLLER_MAXEVENTS	(1024)
+
+#ifdef HAVE_SYS_EPOLL_H
+/*! Poller backend function. */
+static bool PollerEpollOpen(Poller *poller) {
+  register bool result = false;
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else if ((poller->handle = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    Log(L_SYSTEM, "epoll_create1() failed: errno=%d.", errno);
+    poller->handle = INVALID_SOCKET;
+  } else {
+    MemoryCreate(poller->backendData, struct epoll_event, POLLER_MAXEVENTS);
+    result = true;
+  }
+  return (result);
+}
+
+/*! Poller backend function. */
+static void PollerEpollClose(Poller *poller) {
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else {
+    if (poller->handle != INVALID_SOCKET && close(poller->handle) < 0)
+      Log(L_SYSTEM, "close() failed: errno=%d.", errno);
+    poller->handle = INVALID_SOCKET;
+    MemoryFree(poller->backendData);
+  }
+}
+
+/*! Poller backend function. */
+static bool PollerEpollWatch(
+	Poller *poller,
+	const PollerWatch *watch,
+	const int lastEvents) {
+  register bool result = false;
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else if (!watch) {
+    Log(L_ASSERT, "Invalid `watch` PollerWatch.");
+  } else {
+    /* Translate watched events */
+    struct epoll_event event;
+    MemoryZero(&event, struct epoll_event, 1);
+    event.data.fd = watch->handle;
+    event.events = EPOLLRDHUP;
+    if (watch->events & POLLER_READ)
+      event.events |= EPOLLIN;
+    if (watch->events & POLLER_WRITE)
+      event.events |= EPOLLOUT;
+    if (watch->events & POLLER_EDGE)
+      event.events |= EPOLLET;
+
+    /* Add, modify, or delete */
+    const int op = !lastEvents    ? EPOLL_CTL_ADD :
+		   !watch->events ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
+
+    if (epoll_ctl(poller->handle, op, watch->handle, &event) < 0) {
+      /* Closed handles leave the epoll set by themselves */
+      if (op == EPOLL_CTL_DEL && (errno == EBADF || errno == ENOENT)) {
+	result = true;
+      } else {
+	Log(L_SYSTEM, "epoll_ctl() failed: handle=%d, errno=%d.", watch->handle, errno);
+      }
+    } else {
+      result = true;
+    }
+  }
+  return (result);
+}
+
+/*! Poller backend function. */
+static int PollerEpollWait(
+	Poller *poller,
+	Time *timeout) {
+  register int result = -1;
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else {
+    /* Round timeout up to whole milliseconds */
+    const int timeoutMillis = !timeout ? -1 :
+	(int) (timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000);
+
+    /* Wait for network events */
+    struct epoll_event *ready = poller->backendData;
+    const int howMany = epoll_wait(
+	poller->handle,
+	ready, POLLER_MAXEVENTS,
+	timeoutMillis);
+
+    if (howMany < 0 && errno != EINTR) {
+      Log(L_SYSTEM, "epoll_wait() failed: errno=%d.", errno);
+    } else {
+      for (register int readyN = 0; readyN < howMany; ++readyN) {
+	const SOCKET handle = ready[readyN].data.fd;
+	if (handle < 0 || (size_t) handle >= poller->watchesMax)
+	  continue;
+
+	/* Translate ready events */
+	register int events = 0;
+	if (ready[readyN].events & EPOLLIN)
+	  events |= POLLER_READ;
+	if (ready[readyN].events & EPOLLOUT)
+	  events |= POLLER_WRITE;
+	if (ready[readyN].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+	  events |= POLLER_ERROR;
+
+	PollerEvent *event = poller->events + poller->eventsN++;
+	event->events = events;
+	event->handle = handle;
+	event->userData = poller->watches[handle].userData;
+      }
+      result = (int) poller->eventsN;
+    }
+  }
+  return (result);
+}
+
+/*! The epoll(7) poller backend. */
+static const PollerBackend PollerEpoll = {
+  "epoll",
+  PollerEpollOpen,
+  PollerEpollClose,
+  PollerEpollWatch,
+  PollerEpollWait
+};
+#endif /* HAVE_SYS_EPOLL_H */
+
+/*! Poller backend function. */
+static bool PollerSelectOpen(Poller *poller) {
+  return (poller != NULL);
+}
+
+/*! Poller backend function. */
+static void PollerSelectClose(Poller *poller) {
+  (void) poller; /* Nothing */
+}
+
+/*! Poller backend function. */
+static bool PollerSelectWatch(
+	Poller *poller,
+	const PollerWatch *watch,
+	const int lastEvents) {
+  register bool result = false;
+  (void) lastEvents; /* Sets are rebuilt on every wait */
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else if (!watch) {
+    Log(L_ASSERT, "Invalid `watch` PollerWatch.");
+  } else if (watch->handle >= FD_SETSIZE) {
+    LogWarn(L_NETWORK, "Socket handle %d exceeds FD_SETSIZE.", watch->handle);
+  } else {
+    result = true;
+  }
+  return (result);
+}
+
+/*! Poller backend function. */
+static int PollerSelectWait(
+	Poller *poller,
+	Time *timeout) {
+  register int result = -1;
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else {
+    /* Reader sockets */
+    fd_set readers;
+    FD_ZERO(&readers);
+
+    /* Writer sockets */
+    fd_set writers;
+    FD_ZERO(&writers);
+
+    /* Highest valued handle */
+    SOCKET topHandle = INVALID_SOCKET;
+
+    /* Configure read and write sets */
+    for (register size_t watchN = 0; watchN < poller->watchesMax; ++watchN) {
+      const PollerWatch *watch = poller->watches + watchN;
+      if (watch->events & POLLER_READ)
+	FD_SET(watch->handle, &readers);
+      if (watch->events & POLLER_WRITE)
+	FD_SET(watch->handle, &writers);
+      if (watch->events && watch->handle > topHandle)
+	topHandle = watch->handle;
+    }
+
+    /* Wait for network events */
+    const int howMany = select(
+	topHandle + 1, &readers, &writers, NULL, timeout);
+
+    if (howMany < 0 && errno != EINTR) {
+      Log(L_SYSTEM, "select() failed: errno=%d.", errno);
+    } else {
+      for (register SOCKET handle = 0; howMany > 0 && handle <= topHandle; ++handle) {
+	/* Translate ready events */
+	register int events = 0;
+	if (FD_ISSET(handle, &readers))
+	  events |= POLLER_READ;
+	if (FD_ISSET(handle, &writers))
+	  events |= POLLER_WRITE;
+
+	if (events && poller->eventsN < poller->eventsMax) {
+	  PollerEvent *event = poller->events + poller->eventsN++;
+	  event->events = events;
+	  event->handle = handle;
+	  event->userData = poller->watches[handle].userData;
+	}
+      }
+      result = (int) poller->eventsN;
+    }
+  }
+  return (result);
+}
+
+/*! The select(2) poller backend. */
+static const PollerBackend PollerSelect = {
+  "select",
+  PollerSelectOpen,
+  PollerSelectClose,
+  PollerSelectWatch,
+  PollerSelectWait
+};
+
+/*! The poller backends, best first. */
+static const PollerBackend *PollerBackends[] = {
+#ifdef HAVE_SYS_EPOLL_H
+  &PollerEpoll,
+#endif /* HAVE_SYS_EPOLL_H */
+  &PollerSelect,
+  NULL
+};
+
+/*! Poller helper function. */
+static PollerWatch *PollerGetWatch(
+	Poller *poller,
+	Socket *socket) {
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else if (SocketClosed(socket)) {
+    Log(L_ASSERT, "Invalid `socket` Socket.");
+  } else if (socket->handle >= 0 && (size_t) socket->handle < poller->watchesMax) {
+    PollerWatch *watch = poller->watches + socket->handle;
+    if (watch->events)
+      return (watch);
+  }
+  return (NULL);
+}
+
+/*!
+ * Watches a socket.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param socket the socket to watch
+ * \param events the events to watch: POLLER_x
+ * \param userData the user-specified data to report with events
+ * \return true if the specified socket is now watched
+ * \sa PollerRemove(Poller*, Socket*)
+ */
+bool PollerAdd(
+	Poller *poller,
+	Socket *socket,
+	const int events,
+	void *userData) {
+  register bool result = false;
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else if (SocketClosed(socket)) {
+    Log(L_ASSERT, "Invalid `socket` Socket.");
+  } else if (!events) {
+    Log(L_ASSERT, "Invalid `events` value %d.", events);
+  } else if (PollerGetWatch(poller, socket) != NULL) {
+    Log(L_ASSERT, "Socket handle %d is already watched.", socket->handle);
+  } else {
+    /* Grow the watch index */
+    const size_t handle = (size_t) socket->handle;
+    if (handle >= poller->watchesMax) {
+      register size_t watchesMax = poller->watchesMax ? poller->watchesMax : 64;
+      while (watchesMax <= handle)
+	watchesMax *= 2;
+
+      MemoryRecreate(poller->watches, PollerWatch, watchesMax);
+      for (register size_t watchN = poller->watchesMax; watchN < watchesMax; ++watchN) {
+	poller->watches[watchN].events = 0;
+	poller->watches[watchN].handle = (SOCKET) watchN;
+	poller->watches[watchN].userData = NULL;
+      }
+      poller->watchesMax = watchesMax;
+    }
+
+    /* Watch socket */
+    PollerWatch *watch = poller->watches + handle;
+    watch->events = events;
+    watch->userData = userData;
+
+    if (!poller->backend->watch(poller, watch, 0)) {
+      watch->events = 0;
+      watch->userData = NULL;
+    } else {
+      poller->watchesN++;
+      result = true;
+    }
+  }
+  return (result);
+}
+
+/*!
+ * Constructs a new poller.
+ * \addtogroup poller
+ * \param backendName the poller backend name or NULL for the default
+ * \return the new poller or NULL
+ * \sa PollerFree(Poller*)
+ * \sa PollerFreeV(void*)
+ */
+Poller *PollerAlloc(const char *backendName) {
+  /* Search for the poller backend by name */
+  register size_t backendN = 0;
+  if (backendName && *backendName != '\0') {
+    for (; PollerBackends[backendN]; ++backendN) {
+      if (!StringCaseCompare(PollerBackends[backendN]->name, backendName))
+	break;
+    }
+    if (!PollerBackends[backendN]) {
+      Log(L_NETWORK, "Unknown poller backend `%s`.", backendName);
+      backendN = 0;
+    }
+  }
+
+  /* Create poller */
+  Poller *poller;
+  MemoryCreate(poller, Poller, 1);
+  MemoryCreate(poller->events, PollerEvent, POLLER_MAXEVENTS);
+  poller->backend = PollerBackends[backendN];
+  poller->backendData = NULL;
+  poller->eventsMax = POLLER_MAXEVENTS;
+  poller->eventsN = 0;
+  poller->handle = INVALID_SOCKET;
+  poller->watches = NULL;
+  poller->watchesMax = 0;
+  poller->watchesN = 0;
+
+  /* Open poller backend */
+  if (!poller->backend->open(poller)) {
+    Log(L_NETWORK, "Couldn't open `%s` poller backend.", poller->backend->name);
+    PollerFree(poller), poller = NULL;
+  } else {
+    Log(L_NETWORK, "Using `%s` poller backend.", poller->backend->name);
+  }
+  return (poller);
+}
+
+/*!
+ * Frees a poller.
+ * \addtogroup poller
+ * \param poller the poller to free
+ * \sa PollerAlloc(const char*)
+ * \sa PollerFreeV(void*)
+ */
+void PollerFree(Poller *poller) {
+  if (poller) {
+    poller->backend->close(poller);
+    MemoryFree(poller->events);
+    MemoryFree(poller->watches);
+    MemoryFree(poller);
+  }
+}
+
+/*!
+ * Frees a poller.
+ * \addtogroup poller
+ * \param poller the poller to free
+ * \sa PollerAlloc(const char*)
+ * \sa PollerFree(Poller*)
+ */
+void PollerFreeV(void *poller) {
+  PollerFree(poller);
+}
+
+/*!
+ * Changes the watched events of a socket.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param socket the watched socket
+ * \param events the events to watch: POLLER_x
+ * \return true if the watched events were successfully changed
+ */
+bool PollerModify(
+	Poller *poller,
+	Socket *socket,
+	const int events) {
+  register bool result = false;
+  register PollerWatch *watch = NULL;
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else if (!events) {
+    Log(L_ASSERT, "Invalid `events` value %d.", events);
+  } else if ((watch = PollerGetWatch(poller, socket)) == NULL) {
+    Log(L_ASSERT, "Socket is not watched.");
+  } else if (watch->events == events) {
+    result = true;
+  } else {
+    const int lastEvents = watch->events;
+    watch->events = events;
+    if (!poller->backend->watch(poller, watch, lastEvents)) {
+      watch->events = lastEvents;
+    } else {
+      result = true;
+    }
+  }
+  return (result);
+}
+
+/*!
+ * Stops watching a socket.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param socket the socket to stop watching
+ * \sa PollerAdd(Poller*, Socket*, const int, void*)
+ */
+void PollerRemove(
+	Poller *poller,
+	Socket *socket) {
+  register PollerWatch *watch = NULL;
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else if ((watch = PollerGetWatch(poller, socket)) != NULL) {
+    const int lastEvents = watch->events;
+    watch->events = 0;
+    poller->backend->watch(poller, watch, lastEvents);
+    watch->userData = NULL;
+    poller->watchesN--;
+  }
+}
+
+/*!
+ * Waits for network events.
+ * \addtogroup poller
+ * \param poller the poller
+ * \param timeout the interval for which this function should block
+ *     waiting for a watched socket to become ready, or NULL to wait
+ *     indefinitely
+ * \return the number of ready events, or -1
+ */
+int PollerWait(
+	Poller *poller,
+	Time *timeout) {
+  register int result = -1;
+  if (!poller) {
+    Log(L_ASSERT, "Invalid `poller` Poller.");
+  } else {
+    poller->eventsN = 0;
+    result = poller->backend->wait(poller, timeout);
+  }
+  return (result);
+}
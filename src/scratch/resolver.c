@@ -0,0 +1,442 @@
+/*!
+ * \file resolver.c
+ *
+ * \par Copyright
+ * Copyright (C) 1999-2023 scratchmud.org
+ * All rights reserved.
+ *
+ * \author Geoffrey Davis <gdavis@scratchmud.org>
+ * \addtogroup resolver
+ */
+#define _SCRATCH_RESOLVER_C_
+
+#include <scratch/log.h>
+#include <scratch/memory.h>
+#include <scratch/resolver.h>
+#include <scratch/scratch.h>
+#include <scratch/socket.h>
+#include <scratch/string.h>
+
+/* Resolver helper function. */
+static bool ResolverDefault(
+	const SOCKADDR *address,
+	const socklen_t addressSZ,
+	char *hostname, const size_t hostnamelen) {
+  return (getnameinfo(address, addressSZ, hostname, hostnamelen, NULL, 0, NI_NAMEREQD) == 0);
+}
+
+/* Resolver helper function. */
+static void ResolverRequestFree(ResolverRequest *request) {
+  if (request) {
+    StringFree(request->hostname);
+    StringFree(request->key);
+    StringFree(request->numeric);
+    MemoryFree(request);
+  }
+}
+
+#ifdef HAVE_PTHREAD_H
+/* Resolver helper function. */
+static void *ResolverWorker(void *data) {
+  Resolver *resolver = data;
+  pthread_mutex_lock(&resolver->lock);
+  for (;;) {
+    /* Wait for a request */
+    while (resolver->running && !resolver->pending)
+      pthread_cond_wait(&resolver->signal, &resolver->lock);
+    if (!resolver->running)
+      break;
+
+    ResolverRequest *request = resolver->pending;
+    resolver->pending = request->next;
+    if (!resolver->pending)
+      resolver->pendingBack = NULL;
+    pthread_mutex_unlock(&resolver->lock);
+
+    /* Resolve hostname without holding the lock */
+    char hostname[NI_MAXHOST] = {'\0'};
+    if (resolver->resolve(&request->address, request->addressSZ, hostname, sizeof(hostname)))
+      request->hostname = strdup(hostname);
+
+    /* Deliver to the game thread */
+    pthread_mutex_lock(&resolver->lock);
+    request->next = resolver->done;
+    resolver->done = request;
+    if (write(resolver->wakeupWriter, "", 1) < 0 && errno != EAGAIN)
+      Log(L_SYSTEM, "write() failed: errno=%d.", errno);
+  }
+  pthread_mutex_unlock(&resolver->lock);
+  return (NULL);
+}
+#endif /* HAVE_PTHREAD_H */
+
+/*!
+ * Constructs a new resolver.
+ * \addtogroup resolver
+ * \param workersN the number of worker threads, or zero to disable
+ *     hostname resolution
+ * \param cacheMax the maximum number of cached hostnames
+ * \param cacheTtl the number of seconds for which hostnames are cached
+ * \param resolve the hostname resolution function, or NULL for the
+ *     default, which uses getnameinfo()
+ * \return the new resolver or NULL
+ * \sa ResolverFree(Resolver*)
+ * \sa ResolverFreeV(void*)
+ */
+Resolver *ResolverAlloc(
+	const size_t workersN,
+	const size_t cacheMax,
+	const time_t cacheTtl,
+	const ResolverFunc resolve) {
+  Resolver *resolver;
+  MemoryCreate(resolver, Resolver, 1);
+  resolver->bucketsN = 16;
+  while (resolver->bucketsN < cacheMax && resolver->bucketsN < RESOLVER_CACHEMAX_LIMIT)
+    resolver->bucketsN *= 2;
+  MemoryCreate(resolver->buckets, ResolverEntry*, resolver->bucketsN);
+  resolver->cacheMax = cacheMax;
+  resolver->cacheN = 0;
+  resolver->cacheTtl = cacheTtl;
+  resolver->done = NULL;
+  resolver->hits = 0;
+  resolver->lruBack = NULL;
+  resolver->lruFront = NULL;
+  resolver->misses = 0;
+  resolver->pending = NULL;
+  resolver->pendingBack = NULL;
+  resolver->resolve = resolve ? resolve : ResolverDefault;
+  resolver->wakeup = NULL;
+  resolver->wakeupWriter = -1;
+  resolver->workersN = 0;
+
+#ifdef HAVE_PTHREAD_H
+  /* Wakeup pipe */
+  int fds[2];
+  if (!workersN) {
+    /* Hostname resolution disabled */
+  } else if (pipe(fds) < 0) {
+    Log(L_SYSTEM, "pipe() failed: errno=%d.", errno);
+  } else {
+    MemoryCreate(resolver->wakeup, Socket, 1);
+    resolver->wakeup->handle = fds[0];
+    resolver->wakeupWriter = fds[1];
+    SocketNonBlocking(resolver->wakeup);
+    if (fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK) < 0)
+      Log(L_SYSTEM, "fcntl() failed: errno=%d.", errno);
+
+    /* Worker threads */
+    pthread_mutex_init(&resolver->lock, NULL);
+    pthread_cond_init(&resolver->signal, NULL);
+    resolver->running = true;
+    MemoryCreate(resolver->workers, pthread_t, workersN);
+    register size_t i;
+    for (i = 0; i < workersN; ++i) {
+      const int error = pthread_create(&resolver->workers[i], NULL, ResolverWorker, resolver);
+      if (error != 0) {
+	Log(L_SYSTEM, "pthread_create() failed: error=%d.", error);
+	break;
+      }
+      resolver->workersN++;
+    }
+  }
+#else
+  if (workersN)
+    Log(L_SYSTEM, "Hostname resolution requires threads; using numeric addresses.");
+#endif /* HAVE_PTHREAD_H */
+  return (resolver);
+}
+
+/* Resolver helper function. */
+static size_t ResolverHash(
+	const Resolver *resolver,
+	const char *numeric) {
+  register size_t hash = 2166136261u;
+  register const unsigned char *p;
+  for (p = (const unsigned char *) numeric; *p; ++p)
+    hash = (hash ^ *p) * 16777619u;
+  return (hash & (resolver->bucketsN - 1));
+}
+
+/* Resolver helper function. */
+static void ResolverUnlink(
+	Resolver *resolver,
+	ResolverEntry *entry) {
+  if (entry->lruPrev)
+    entry->lruPrev->lruNext = entry->lruNext;
+  else
+    resolver->lruFront = entry->lruNext;
+  if (entry->lruNext)
+    entry->lruNext->lruPrev = entry->lruPrev;
+  else
+    resolver->lruBack = entry->lruPrev;
+  entry->lruNext = entry->lruPrev = NULL;
+}
+
+/* Resolver helper function. */
+static void ResolverLinkFront(
+	Resolver *resolver,
+	ResolverEntry *entry) {
+  entry->lruPrev = NULL;
+  entry->lruNext = resolver->lruFront;
+  if (resolver->lruFront)
+    resolver->lruFront->lruPrev = entry;
+  else
+    resolver->lruBack = entry;
+  resolver->lruFront = entry;
+}
+
+/* Resolver helper function. */
+static void ResolverEvict(
+	Resolver *resolver,
+	ResolverEntry *entry) {
+  /* Unlink from hash bucket */
+  ResolverEntry **link = &resolver->buckets[ResolverHash(resolver, entry->address)];
+  while (*link && *link != entry)
+    link = &(*link)->next;
+  if (*link)
+    *link = entry->next;
+
+  ResolverUnlink(resolver, entry);
+  StringFree(entry->address);
+  StringFree(entry->hostname);
+  MemoryFree(entry);
+  resolver->cacheN--;
+}
+
+/* Resolver helper function. */
+static ResolverEntry *ResolverFind(
+	Resolver *resolver,
+	const char *numeric) {
+  register ResolverEntry *entry = resolver->buckets[ResolverHash(resolver, numeric)];
+  while (entry && strcmp(entry->address, numeric) != 0)
+    entry = entry->next;
+  return (entry);
+}
+
+/* Resolver helper function. */
+static void ResolverPut(
+	Resolver *resolver,
+	const char *numeric,
+	const char *hostname) {
+  if (!resolver->cacheMax)
+    return;
+
+  ResolverEntry *entry = ResolverFind(resolver, numeric);
+  if (entry) {
+    /* Refresh cached entry */
+    StringFree(entry->hostname);
+    ResolverUnlink(resolver, entry);
+  } else {
+    /* Evict least recently used entry */
+    if (resolver->cacheN >= resolver->cacheMax)
+      ResolverEvict(resolver, resolver->lruBack);
+
+    const size_t bucket = ResolverHash(resolver, numeric);
+    MemoryCreate(entry, ResolverEntry, 1);
+    entry->address = strdup(numeric);
+    entry->next = resolver->buckets[bucket];
+    resolver->buckets[bucket] = entry;
+    resolver->cacheN++;
+  }
+  entry->expires = time(NULL) + resolver->cacheTtl;
+  entry->hostname = strdup(hostname);
+  ResolverLinkFront(resolver, entry);
+}
+
+/*!
+ * Frees a resolver.
+ * \addtogroup resolver
+ * \param resolver the resolver to free
+ * \sa ResolverAlloc(const size_t, const size_t, const time_t, const ResolverFunc)
+ * \sa ResolverFreeV(void*)
+ */
+void ResolverFree(Resolver *resolver) {
+  if (resolver) {
+#ifdef HAVE_PTHREAD_H
+    /* Stop worker threads */
+    if (resolver->wakeup) {
+      pthread_mutex_lock(&resolver->lock);
+      resolver->running = false;
+      pthread_cond_broadcast(&resolver->signal);
+      pthread_mutex_unlock(&resolver->lock);
+
+      register size_t i;
+      for (i = 0; i < resolver->workersN; ++i)
+	pthread_join(resolver->workers[i], NULL);
+      MemoryFree(resolver->workers);
+      pthread_cond_destroy(&resolver->signal);
+      pthread_mutex_destroy(&resolver->lock);
+    }
+#endif /* HAVE_PTHREAD_H */
+
+    /* Free outstanding requests */
+    ResolverRequest *request;
+    while ((request = resolver->pending) != NULL) {
+      resolver->pending = request->next;
+      ResolverRequestFree(request);
+    }
+    while ((request = resolver->done) != NULL) {
+      resolver->done = request->next;
+      ResolverRequestFree(request);
+    }
+
+    /* Free cache */
+    while (resolver->lruFront)
+      ResolverEvict(resolver, resolver->lruFront);
+    MemoryFree(resolver->buckets);
+
+    /* Close wakeup pipe */
+    SocketFree(resolver->wakeup);
+    if (resolver->wakeupWriter >= 0 && close(resolver->wakeupWriter) < 0)
+      Log(L_SYSTEM, "close() failed: errno=%d.", errno);
+    MemoryFree(resolver);
+  }
+}
+
+/*!
+ * Frees a resolver.
+ * \addtogroup resolver
+ * \param resolver the resolver to free
+ * \sa ResolverAlloc(const size_t, const size_t, const time_t, const ResolverFunc)
+ * \sa ResolverFree(Resolver*)
+ */
+void ResolverFreeV(void *resolver) {
+  ResolverFree(resolver);
+}
+
+/*!
+ * Returns a cached hostname.
+ * \addtogroup resolver
+ * \param resolver the resolver
+ * \param numeric the numeric address whose hostname to return
+ * \return the cached hostname for the specified address, or NULL
+ */
+const char *ResolverGet(
+	Resolver *resolver,
+	const char *numeric) {
+  register const char *result = NULL;
+  if (!resolver) {
+    Log(L_ASSERT, "Invalid `resolver` Resolver.");
+  } else if (!numeric) {
+    Log(L_ASSERT, "Invalid `numeric` string.");
+  } else {
+    ResolverEntry *entry = ResolverFind(resolver, numeric);
+    if (entry && entry->expires <= time(NULL)) {
+      /* Expired entry */
+      ResolverEvict(resolver, entry);
+      entry = NULL;
+    }
+
+    if (!entry) {
+      resolver->misses++;
+    } else {
+      /* Mark most recently used */
+      ResolverUnlink(resolver, entry);
+      ResolverLinkFront(resolver, entry);
+      resolver->hits++;
+      result = entry->hostname;
+    }
+  }
+  return (result);
+}
+
+/*!
+ * Delivers resolved hostnames.  Call when the wakeup socket
+ * becomes readable.
+ * \addtogroup resolver
+ * \param resolver the resolver
+ * \param done the function to call for each resolved hostname
+ * \param userData the user-specified data to pass to \p done
+ * \return the number of resolved hostnames delivered
+ */
+size_t ResolverPoll(
+	Resolver *resolver,
+	const ResolverDoneFunc done,
+	void *userData) {
+  register size_t result = 0;
+  if (!resolver) {
+    Log(L_ASSERT, "Invalid `resolver` Resolver.");
+  } else if (!done) {
+    Log(L_ASSERT, "Invalid `done` ResolverDoneFunc.");
+  } else if (resolver->wakeup) {
+#ifdef HAVE_PTHREAD_H
+    /* Drain wakeup pipe; the final EAGAIN mustn't leak to the caller */
+    const int savedErrno = errno;
+    char drain[256];
+    while (read(resolver->wakeup->handle, drain, sizeof(drain)) > 0)
+      continue;
+    errno = savedErrno;
+
+    /* Take resolved requests */
+    pthread_mutex_lock(&resolver->lock);
+    ResolverRequest *request = resolver->done;
+    resolver->done = NULL;
+    pthread_mutex_unlock(&resolver->lock);
+
+    while (request) {
+      ResolverRequest *next = request->next;
+
+      /* Failed lookups are cached as the numeric address */
+      const char *hostname = request->hostname ? request->hostname : request->numeric;
+      ResolverPut(resolver, request->numeric, hostname);
+      done(request->key, request->numeric, hostname, userData);
+      ResolverRequestFree(request);
+      request = next;
+      ++result;
+    }
+#endif /* HAVE_PTHREAD_H */
+  }
+  return (result);
+}
+
+/*!
+ * Queues a hostname lookup.
+ * \addtogroup resolver
+ * \param resolver the resolver
+ * \param key the requester key to deliver with the hostname
+ * \param address the address to resolve
+ * \param addressSZ the length of the specified address
+ * \param numeric the numeric form of the specified address
+ * \return true if the lookup was queued
+ * \sa ResolverPoll(Resolver*, const ResolverDoneFunc, void*)
+ */
+bool ResolverQueue(
+	Resolver *resolver,
+	const char *key,
+	const SOCKADDR *address,
+	const socklen_t addressSZ,
+	const char *numeric) {
+  register bool result = false;
+  if (!resolver) {
+    Log(L_ASSERT, "Invalid `resolver` Resolver.");
+  } else if (!key) {
+    Log(L_ASSERT, "Invalid `key` string.");
+  } else if (!address || addressSZ > sizeof(SOCKADDR)) {
+    Log(L_ASSERT, "Invalid `address` SOCKADDR.");
+  } else if (!numeric) {
+    Log(L_ASSERT, "Invalid `numeric` string.");
+  } else if (resolver->workersN) {
+#ifdef HAVE_PTHREAD_H
+    ResolverRequest *request;
+    MemoryCreate(request, ResolverRequest, 1);
+    MemoryCopy(&request->address, address, char, addressSZ);
+    request->addressSZ = addressSZ;
+    request->hostname = NULL;
+    request->key = strdup(key);
+    request->next = NULL;
+    request->numeric = strdup(numeric);
+
+    /* Hand off to a worker */
+    pthread_mutex_lock(&resolver->lock);
+    if (resolver->pendingBack)
+      resolver->pendingBack->next = request;
+    else
+      resolver->pending = request;
+    resolver->pendingBack = request;
+    pthread_cond_signal(&resolver->signal);
+    pthread_mutex_unlock(&resolver->lock);
+    result = true;
+#endif /* HAVE_PTHREAD_H */
+  }
+  return (result);
+}
@@ -247,7 +247,8 @@ bool SocketOpen(
  * \param socket the socket from which to read
  * \param messg the message buffer
  * \param messglen the length of the specified buffer
- * \return the number of bytes read from the network stream, or -1
+ * \return the number of bytes read from the network stream, zero if
+ *     no data is available, or -1 on error or end of stream
  * \sa SocketWrite(Socket*, const void*, const size_t)
  */
 ssize_t SocketRead(
@@ -266,30 +267,39 @@ ssize_t SocketRead(
     if (result > 0)
       socket->bytesReceived += result;
 
+    if (result == 0 && messglen) {
+      /* Remote host closed the network stream */
+      result = -1;
+    } else if (result < 0) {
+      /*
+       * An error was encountered - is it transient?  Only consulted
+       * when read() fails, since it leaves errno stale on success.
+       */
 #ifdef EINTR
-    if (result < 0 && errno == EINTR)
-      result = 0;
+      if (errno == EINTR)
+	result = 0;
 #endif /* EINTR */
 
 #ifdef EAGAIN /* POSIX */
-    if (result < 0 && errno == EAGAIN)
-      result = 0;
+      if (errno == EAGAIN)
+	result = 0;
 #endif /* EAGAIN */
 
 #ifdef EWOULDBLOCK /* BSD */
-    if (result < 0 && errno == EWOULDBLOCK)
-      result = 0;
+      if (errno == EWOULDBLOCK)
+	result = 0;
 #endif /* EWOULDBLOCK */
 
 #ifdef EDEADLK /* Macintosh */
-    if (result < 0 && errno == EDEADLK)
-      result = 0;
+      if (errno == EDEADLK)
+	result = 0;
 #endif /* EDEADLK */
 
 #ifdef ECONNRESET
-    if (result < 0 && errno == ECONNRESET)
-      result = -1;
+      if (errno == ECONNRESET)
+	result = -1;
 #endif /* ECONNRESET */
+    }
   }
   return (result);
 }
@@ -300,6 +310,18 @@ ssize_t SocketRead(
  * \sa SocketCleanup()
  */
 void SocketStartup(void) {
+#ifdef HAVE_SYS_RESOURCE_H
+  /* Allow as many sockets as the hard limit permits */
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+    Log(L_SYSTEM, "getrlimit() failed: errno=%d.", errno);
+  } else if (limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) < 0)
+      Log(L_SYSTEM, "setrlimit() failed: errno=%d.", errno);
+  }
+#endif /* HAVE_SYS_RESOURCE_H */
+
 #ifdef _WIN32
   WORD wVersionRequested = MAKEWORD(2, 2);
   WSADATA wsaData;
@@ -359,3 +381,54 @@ ssize_t SocketWrite(
   }
   return (result);
 }
+
+#ifdef HAVE_SYS_UIO_H
+/*!
+ * Writes to a socket from several buffers at once.
+ * \addtogroup socket
+ * \param socket the socket to which to write
+ * \param iov the message buffers
+ * \param iovN the number of message buffers
+ * \return the number of bytes written to the network stream, or -1
+ * \sa SocketWrite(Socket*, const void*, const size_t)
+ */
+ssize_t SocketWriteVector(
+	Socket *socket,
+	const struct iovec *iov, const size_t iovN) {
+  register ssize_t result = -1;
+  if (!socket) {
+    Log(L_ASSERT, "Invalid `socket` Socket.");
+  } else if (!iov && iovN) {
+    Log(L_ASSERT, "Invalid `iov` buffer.");
+  } else {
+    /* Write to network stream */
+    result = writev(socket->handle, iov, iovN);
+
+    /* Update statistics */
+    if (result > 0)
+      socket->bytesSent += result;
+
+    if (result < 0) {
+      /*
+       * An error was encountered - is it transient?  Only consulted
+       * when writev() fails, since it leaves errno stale on success.
+       */
+#ifdef EAGAIN /* POSIX */
+      if (errno == EAGAIN)
+	result = 0;
+#endif /* EAGAIN */
+
+#ifdef EWOULDBLOCK /* BSD */
+      if (errno == EWOULDBLOCK)
+	result = 0;
+#endif /* EWOULDBLOCK */
+
+#ifdef EDEADLK /* Macintosh */
+      if (errno == EDEADLK)
+	result = 0;
+#endif /* EDEADLK */
+    }
+  }
+  return (result);
+}
+#endif /* HAVE_SYS_UIO_H */
@@ -0,0 +1,54 @@
+#!/bin/bash
+#
+# ScratchMUD disconnect regression test.
+# A client that disconnects after its hostname is resolved must be
+# noticed and closed.
+#
+# \par Copyright
+# Copyright (C) 1999-2023 scratchmud.org
+# All rights reserved.
+#
+# \author Geoffrey Davis <gdavis@scratchmud.org>
+
+Server="$PWD/bin/scratch"
+Port=6767
+WorkDir=$(mktemp -d) || exit 99
+trap 'kill $ServerPid 2>/dev/null; wait $ServerPid 2>/dev/null; rm -rf "$WorkDir"' EXIT
+
+# Wait up to five seconds for a log message.
+WaitForLog() {
+  for i in $(seq 50); do
+    if grep -q "$1" "$WorkDir"/log/*.log 2>/dev/null; then
+      return 0
+    fi
+    sleep 0.1
+  done
+  return 1
+}
+
+# Run the server from a private copy of the game data.
+cp -R "${srcdir:-.}/data" "$WorkDir/" && mkdir "$WorkDir/log" || exit 99
+(cd "$WorkDir" && exec "$Server") &
+ServerPid=$!
+if ! WaitForLog "Opened server on port $Port"; then
+  echo "Server didn't open port $Port; skipping."
+  exit 77
+fi
+
+# Connect and let the resolver answer.
+exec 3<>/dev/tcp/127.0.0.1/$Port || exit 99
+WaitForLog "Accepted descriptor" || { echo "Descriptor wasn't accepted."; exit 1; }
+WaitForLog "Resolved descriptor" || sleep 1
+
+# Read the greeting so that disconnecting ends the stream cleanly
+# rather than resetting it.
+read -r -t 1 -N 4096 -u 3 _
+
+# Disconnect.
+exec 3<&- 3>&-
+if ! WaitForLog "Lost descriptor"; then
+  echo "Disconnected descriptor wasn't closed."
+  cat "$WorkDir"/log/*.log
+  exit 1
+fi
+exit 0